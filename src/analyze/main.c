@@ -0,0 +1,580 @@
+/* offline analysis of the per sample traces recorded by stat -trace */
+
+/* the trace file is mapped and split in contiguous chunks, one per */
+/* thread. each thread builds its own histogram, window statistics */
+/* and outlier list, which are merged once all the threads are done. */
+/* exact order statistics are computed on the raw REG_FCLK latencies */
+/* using a parallel radix selection: each pass counts the next digit */
+/* of the samples matching the prefix selected so far, so that no */
+/* sample is ever copied or sorted. */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include "hist.h"
+#include "trace.h"
+
+
+#define CONFIG_DEBUG 1
+#if (CONFIG_DEBUG == 1)
+#define PERROR() \
+do { printf("[!] %s,%d\n", __FILE__, __LINE__); } while (0)
+#else
+#define PERROR()
+#endif
+
+
+/* same histogram layout as stat */
+
+#define LAT_MAX_US 1000000
+#define LAT_RES_US 1
+#define LAT_MAX_COUNT (LAT_MAX_US / LAT_RES_US)
+
+
+/* command line parsing */
+
+typedef struct cmdline
+{
+  const char* path;
+  size_t nthreads;
+  size_t window;
+  uint32_t outlier_us;
+} cmdline_t;
+
+static uint32_t get_num(const char* s)
+{
+  int base = 10;
+  if ((strlen(s) > 2) && (s[0] == '0') && (s[1] == 'x')) base = 16;
+  return (uint32_t)strtoul(s, NULL, base);
+}
+
+static int get_cmdline(cmdline_t* cmd, size_t ac, char** av)
+{
+  /* -trace <path>: the trace file to analyze */
+  /* -threads <count>: worker threads. 0 or none is one per cpu. */
+  /* -window <count>: samples per window statistics. 0 or none is off. */
+  /* -outlier <us>: list samples above this latency. 0 or none is off. */
+
+  size_t i;
+
+  if (ac & 1) goto on_error;
+
+  cmd->path = NULL;
+  cmd->nthreads = 0;
+  cmd->window = 0;
+  cmd->outlier_us = 0;
+
+  for (i = 0; i != ac; i += 2)
+  {
+    if (strcmp(av[i], "-trace") == 0) cmd->path = av[i + 1];
+    else if (strcmp(av[i], "-threads") == 0) cmd->nthreads = get_num(av[i + 1]);
+    else if (strcmp(av[i], "-window") == 0) cmd->window = get_num(av[i + 1]);
+    else if (strcmp(av[i], "-outlier") == 0)
+      cmd->outlier_us = get_num(av[i + 1]);
+    else goto on_error;
+  }
+
+  if (cmd->path == NULL) goto on_error;
+
+  if (cmd->nthreads == 0)
+  {
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    cmd->nthreads = (n > 0) ? (size_t)n : 1;
+  }
+
+  return 0;
+ on_error:
+  return -1;
+}
+
+
+/* order statistics */
+
+static const double pct[] = { 0, 50, 90, 99, 99.9, 99.99, 100 };
+static const char* const pct_name[] =
+  { "min", "p50", "p90", "p99", "p99.9", "p99.99", "max" };
+#define PCT_COUNT (sizeof(pct) / sizeof(pct[0]))
+
+/* 3 passes of 11, 11 and 10 bits */
+#define RADIX_BITS 11
+#define RADIX_SIZE (1 << RADIX_BITS)
+static const unsigned int radix_shift[] = { 21, 10, 0 };
+static const uint32_t radix_mask[] = { 0x7ff, 0x7ff, 0x3ff };
+#define RADIX_PASSES (sizeof(radix_shift) / sizeof(radix_shift[0]))
+
+typedef struct select_state
+{
+  /* rank of the searched sample, 0 based */
+  uint64_t rank;
+  /* digits selected so far, and the mask of these digits */
+  uint32_t prefix;
+  uint32_t prefix_mask;
+} select_state_t;
+
+
+/* per window statistics */
+
+typedef struct window_stat
+{
+  uint64_t n;
+  uint64_t sum;
+  uint32_t min;
+  uint32_t max;
+  uint64_t missed;
+} window_stat_t;
+
+
+/* per thread work */
+
+typedef struct outlier
+{
+  size_t index;
+  uint32_t count;
+  uint32_t lat_us;
+} outlier_t;
+
+typedef struct work
+{
+  const cmdline_t* cmd;
+  const trace_map_t* map;
+  uint64_t max_ticks;
+  size_t first;
+  size_t last;
+  pthread_t thread;
+
+  /* first pass */
+  hist_t hist;
+  uint64_t nsamples;
+  /* missed IRQs, and waits stat counts as one miss each */
+  uint64_t missed;
+  uint64_t waits_missed;
+  window_stat_t* windows;
+  outlier_t* outliers;
+  size_t noutliers;
+  size_t outliers_size;
+
+  /* radix passes */
+  size_t pass;
+  const select_state_t* states;
+  uint64_t (*counts)[RADIX_SIZE];
+
+  int err;
+} work_t;
+
+static uint32_t ticks_to_us(const trace_map_t* map, uint32_t x)
+{
+  return (uint32_t)
+    (((uint64_t)x * (uint64_t)1000000) / (uint64_t)map->header->fclk);
+}
+
+static int add_outlier(work_t* w, size_t i, uint32_t count, uint32_t lat_us)
+{
+  if (w->noutliers == w->outliers_size)
+  {
+    const size_t size = (w->outliers_size == 0) ? 1024 : 2 * w->outliers_size;
+    outlier_t* const p = realloc(w->outliers, size * sizeof(outlier_t));
+    if (p == NULL) return -1;
+    w->outliers = p;
+    w->outliers_size = size;
+  }
+
+  w->outliers[w->noutliers].index = i;
+  w->outliers[w->noutliers].count = count;
+  w->outliers[w->noutliers].lat_us = lat_us;
+  ++w->noutliers;
+
+  return 0;
+}
+
+static void* first_pass_main(void* args)
+{
+  /* histogram, misses, windows, outliers and the first radix digit */
+
+  work_t* const w = (work_t*)args;
+  const trace_rec_t* const recs = w->map->recs;
+  uint64_t* const counts = w->counts[0];
+  window_stat_t* ws = NULL;
+  uint32_t prev_count = 0;
+  int has_prev = 0;
+  uint32_t ticks;
+  uint32_t lat_us;
+  size_t i;
+
+  w->err = -1;
+
+  /* the previous valid sample, possibly in the previous chunk */
+
+  for (i = w->first; i != 0; --i)
+  {
+    if (recs[i - 1].mask == 0) continue ;
+    prev_count = recs[i - 1].count;
+    has_prev = 1;
+    break ;
+  }
+
+  for (i = w->first; i != w->last; ++i)
+  {
+    const trace_rec_t* const rec = &recs[i];
+
+    if (w->windows != NULL) ws = &w->windows[i / w->cmd->window];
+
+    if (rec->mask == 0) continue ;
+
+    /* missed IRQs, either counted by the device or too late. a count */
+    /* gap is as many IRQs as it skips, as stat -batch does. stat */
+    /* without -batch counts the wait once, whatever the gap size */
+
+    ticks = trace_rec_ticks(rec);
+
+    if (has_prev && (rec->count != (prev_count + 1)))
+    {
+      w->missed += (uint64_t)(rec->count - prev_count - 1);
+      if (ws != NULL) ws->missed += (uint64_t)(rec->count - prev_count - 1);
+      ++w->waits_missed;
+    }
+    else if ((uint64_t)ticks >= w->max_ticks)
+    {
+      ++w->waits_missed;
+    }
+    prev_count = rec->count;
+    has_prev = 1;
+
+    if ((uint64_t)ticks >= w->max_ticks)
+    {
+      ++w->missed;
+      if (ws != NULL) ++ws->missed;
+      continue ;
+    }
+
+    lat_us = ticks_to_us(w->map, ticks);
+    hist_record(&w->hist, lat_us);
+
+    ++w->nsamples;
+    ++counts[ticks >> radix_shift[0]];
+
+    if (ws != NULL)
+    {
+      if ((ws->n == 0) || (lat_us < ws->min)) ws->min = lat_us;
+      if ((ws->n == 0) || (lat_us > ws->max)) ws->max = lat_us;
+      ws->sum += lat_us;
+      ++ws->n;
+    }
+
+    if (w->cmd->outlier_us && (lat_us >= w->cmd->outlier_us))
+    {
+      if (add_outlier(w, i, rec->count, lat_us)) goto on_error;
+    }
+  }
+
+  w->err = 0;
+ on_error:
+  return NULL;
+}
+
+static void* radix_pass_main(void* args)
+{
+  /* count the pass digit of samples matching each percentile prefix */
+
+  work_t* const w = (work_t*)args;
+  const trace_rec_t* const recs = w->map->recs;
+  const unsigned int shift = radix_shift[w->pass];
+  const uint32_t mask = radix_mask[w->pass];
+  uint32_t ticks;
+  size_t i;
+  size_t k;
+
+  for (i = w->first; i != w->last; ++i)
+  {
+    const trace_rec_t* const rec = &recs[i];
+
+    if (rec->mask == 0) continue ;
+
+    ticks = trace_rec_ticks(rec);
+    if ((uint64_t)ticks >= w->max_ticks) continue ;
+
+    for (k = 0; k != PCT_COUNT; ++k)
+    {
+      const select_state_t* const s = &w->states[k];
+      if ((ticks & s->prefix_mask) != s->prefix) continue ;
+      ++w->counts[k][(ticks >> shift) & mask];
+    }
+  }
+
+  w->err = 0;
+  return NULL;
+}
+
+static int run_workers(work_t* works, size_t n, void* (*fn)(void*))
+{
+  size_t i;
+  int err = 0;
+
+  for (i = 0; i != n; ++i)
+  {
+    if (pthread_create(&works[i].thread, NULL, fn, &works[i])) break ;
+  }
+
+  /* on error, the started workers still have to be joined */
+
+  if (i != n)
+  {
+    n = i;
+    err = -1;
+  }
+
+  for (i = 0; i != n; ++i)
+  {
+    pthread_join(works[i].thread, NULL);
+    if (works[i].err) err = -1;
+  }
+
+  return err;
+}
+
+static void select_digit
+(select_state_t* s, const uint64_t* counts, size_t pass)
+{
+  /* find the bucket containing rank, and make the rank relative to it */
+
+  const unsigned int shift = radix_shift[pass];
+  uint32_t d;
+
+  for (d = 0; d != radix_mask[pass]; ++d)
+  {
+    if (s->rank < counts[d]) break ;
+    s->rank -= counts[d];
+  }
+
+  s->prefix |= d << shift;
+  s->prefix_mask |= radix_mask[pass] << shift;
+}
+
+
+/* main */
+
+int main(int ac, char** av)
+{
+  cmdline_t cmd;
+  trace_map_t map;
+  work_t* works;
+  window_stat_t* windows = NULL;
+  size_t nwindows = 0;
+  select_state_t states[PCT_COUNT];
+  uint64_t (*counts)[RADIX_SIZE];
+  uint32_t ticks[PCT_COUNT];
+  hist_t hist;
+  uint64_t nsamples = 0;
+  uint64_t missed = 0;
+  uint64_t waits_missed = 0;
+  struct timespec ta;
+  struct timespec tb;
+  double elapsed;
+  double mean;
+  double stddev;
+  uint64_t max_ticks;
+  size_t chunk;
+  size_t nworks;
+  size_t pass;
+  size_t i;
+  size_t j;
+  size_t k;
+  int err = -1;
+
+  if (get_cmdline(&cmd, (size_t)ac - 1, av + 1)) goto on_error_0;
+
+  if (trace_map_open(&map, cmd.path))
+  {
+    PERROR();
+    goto on_error_0;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &ta);
+
+  /* samples of at least LAT_MAX_US are missed, as in stat */
+
+  max_ticks = ((uint64_t)LAT_MAX_US * map.header->fclk + 999999) / 1000000;
+
+  /* split in chunks, aligned on windows so that no window is shared */
+
+  nworks = cmd.nthreads;
+  chunk = (map.nrecs + nworks - 1) / nworks;
+  if (cmd.window)
+  {
+    chunk = ((chunk + cmd.window - 1) / cmd.window) * cmd.window;
+    nwindows = (map.nrecs + cmd.window - 1) / cmd.window;
+    windows = calloc(nwindows ? nwindows : 1, sizeof(window_stat_t));
+    if (windows == NULL) goto on_error_1;
+  }
+  if (chunk == 0) chunk = 1;
+
+  works = calloc(nworks, sizeof(work_t));
+  if (works == NULL) goto on_error_2;
+
+  counts = calloc(nworks * PCT_COUNT, sizeof(counts[0]));
+  if (counts == NULL) goto on_error_3;
+
+  for (i = 0; i != nworks; ++i)
+  {
+    work_t* const w = &works[i];
+    w->cmd = &cmd;
+    w->map = &map;
+    w->max_ticks = max_ticks;
+    w->first = i * chunk;
+    w->last = w->first + chunk;
+    if (w->first > map.nrecs) w->first = map.nrecs;
+    if (w->last > map.nrecs) w->last = map.nrecs;
+    w->windows = windows;
+    w->states = states;
+    w->counts = counts + i * PCT_COUNT;
+    if (hist_init(&w->hist, LAT_MAX_COUNT, LAT_RES_US)) goto on_error_4;
+  }
+
+  if (run_workers(works, nworks, first_pass_main))
+  {
+    PERROR();
+    goto on_error_4;
+  }
+
+  /* merge first pass results */
+
+  if (hist_init(&hist, LAT_MAX_COUNT, LAT_RES_US)) goto on_error_4;
+
+  for (i = 0; i != nworks; ++i)
+  {
+    hist_merge(&hist, &works[i].hist);
+    nsamples += works[i].nsamples;
+    missed += works[i].missed;
+    waits_missed += works[i].waits_missed;
+  }
+
+  /* radix selection. the first digit was counted by the first pass. */
+
+  for (k = 0; k != PCT_COUNT; ++k)
+  {
+    /* same rank definition as hist_percentiles */
+    states[k].rank = (uint64_t)ceil(pct[k] / 100.0 * (double)nsamples);
+    if (states[k].rank != 0) --states[k].rank;
+    if (states[k].rank >= nsamples)
+      states[k].rank = nsamples ? nsamples - 1 : 0;
+    states[k].prefix = 0;
+    states[k].prefix_mask = 0;
+  }
+
+  for (pass = 0; (nsamples != 0) && (pass != RADIX_PASSES); ++pass)
+  {
+    if (pass != 0)
+    {
+      memset(counts, 0, nworks * PCT_COUNT * sizeof(counts[0]));
+      for (i = 0; i != nworks; ++i) works[i].pass = pass;
+      if (run_workers(works, nworks, radix_pass_main))
+      {
+	PERROR();
+	goto on_error_5;
+      }
+    }
+
+    for (k = 0; k != PCT_COUNT; ++k)
+    {
+      /* the first pass counts are shared by all the percentiles */
+
+      const size_t kk = (pass == 0) ? 0 : k;
+      uint64_t sum[RADIX_SIZE];
+
+      for (j = 0; j != RADIX_SIZE; ++j)
+      {
+	sum[j] = 0;
+	for (i = 0; i != nworks; ++i) sum[j] += counts[i * PCT_COUNT + kk][j];
+      }
+
+      select_digit(&states[k], sum, pass);
+    }
+  }
+
+  for (k = 0; k != PCT_COUNT; ++k) ticks[k] = states[k].prefix;
+
+  clock_gettime(CLOCK_MONOTONIC, &tb);
+  elapsed = (double)(tb.tv_sec - ta.tv_sec) +
+    (double)(tb.tv_nsec - ta.tv_nsec) / 1000000000.0;
+
+  /* report */
+
+  printf("# trace      : %s\n", cmd.path);
+  printf("# fclk       : %u\n", map.header->fclk);
+  printf("# fgen       : %u\n", map.header->fgen);
+  printf("# records    : %zu\n", map.nrecs);
+  printf("# samples    : %llu\n", (unsigned long long)nsamples);
+  /* irq_missed counts each skipped IRQ, as stat -batch. wait_missed */
+  /* counts each late or gapped wait once, as stat without -batch */
+
+  printf("# irq_missed : %llu\n", (unsigned long long)missed);
+  printf("# wait_missed: %llu\n", (unsigned long long)waits_missed);
+  printf("# threads    : %zu\n", nworks);
+  printf("# elapsed    : %.3f\n", elapsed);
+  if (elapsed > 0)
+    printf("# samples_per_sec: %.0f\n", (double)map.nrecs / elapsed);
+
+  if (hist_moments(&hist, &mean, &stddev) == 0)
+  {
+    printf("# lat_mean   : %.3f\n", mean);
+    printf("# lat_stddev : %.3f\n", stddev);
+  }
+
+  /* exact values, in ticks and microseconds */
+
+  for (k = 0; (nsamples != 0) && (k != PCT_COUNT); ++k)
+  {
+    printf("# lat_%-7s: %u %.3f\n", pct_name[k], ticks[k],
+	   (double)ticks[k] * 1000000.0 / (double)map.header->fclk);
+  }
+
+  for (i = 0; i != nwindows; ++i)
+  {
+    const window_stat_t* const ws = &windows[i];
+    if (ws->n == 0)
+    {
+      printf("# window %zu 0 - - - %llu\n", i, (unsigned long long)ws->missed);
+      continue ;
+    }
+    printf("# window %zu %llu %u %.3f %u %llu\n",
+	   i, (unsigned long long)ws->n, ws->min,
+	   (double)ws->sum / (double)ws->n, ws->max,
+	   (unsigned long long)ws->missed);
+  }
+
+  for (i = 0; i != nworks; ++i)
+  {
+    for (j = 0; j != works[i].noutliers; ++j)
+    {
+      const outlier_t* const o = &works[i].outliers[j];
+      printf("# outlier %zu %u %u\n", o->index, o->count, o->lat_us);
+    }
+  }
+
+  hist_print(&hist, stdout);
+
+  err = 0;
+
+ on_error_5:
+  hist_fini(&hist);
+ on_error_4:
+  for (i = 0; i != nworks; ++i)
+  {
+    if (works[i].hist.bins != NULL) hist_fini(&works[i].hist);
+    free(works[i].outliers);
+  }
+  free(counts);
+ on_error_3:
+  free(works);
+ on_error_2:
+  free(windows);
+ on_error_1:
+  trace_map_close(&map);
+ on_error_0:
+  return err;
+}
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "cgroup.h"
+
+
+static int make_path(char* buf, const char* dir, const char* file)
+{
+  int n;
+
+  if (file == NULL)
+    n = snprintf(buf, CGROUP_PATH_SIZE, "%s/%s", CGROUP_MOUNT, dir);
+  else n = snprintf(buf, CGROUP_PATH_SIZE, "%s/%s/%s", CGROUP_MOUNT, dir, file);
+
+  if ((n < 0) || (n >= CGROUP_PATH_SIZE)) return -1;
+  return 0;
+}
+
+int cgroup_write(const char* dir, const char* file, const char* value)
+{
+  /* cgroup files take one value per write */
+
+  char path[CGROUP_PATH_SIZE];
+  const size_t len = strlen(value);
+  int fd;
+  int err = -1;
+
+  if (make_path(path, dir, file)) goto on_error_0;
+
+  fd = open(path, O_WRONLY);
+  if (fd == -1) goto on_error_0;
+  if (write(fd, value, len) != (ssize_t)len) goto on_error_1;
+
+  err = 0;
+
+ on_error_1:
+  close(fd);
+ on_error_0:
+  return err;
+}
+
+int cgroup_read(const char* dir, const char* file, char* buf, size_t size)
+{
+  char path[CGROUP_PATH_SIZE];
+  ssize_t n;
+  int fd;
+
+  if (size == 0) return -1;
+  if (make_path(path, dir, file)) return -1;
+
+  fd = open(path, O_RDONLY);
+  if (fd == -1) return -1;
+  n = read(fd, buf, size - 1);
+  close(fd);
+  if (n < 0) return -1;
+
+  /* strip the trailing newline */
+  if ((n != 0) && (buf[n - 1] == '\n')) --n;
+  buf[n] = 0;
+
+  return 0;
+}
+
+int cgroup_create(const char* dir)
+{
+  char path[CGROUP_PATH_SIZE];
+
+  if (make_path(path, dir, NULL)) return -1;
+  if (mkdir(path, 0755) && (errno != EEXIST)) return -1;
+
+  return 0;
+}
+
+int cgroup_destroy(const char* dir)
+{
+  /* the group must not contain any process */
+
+  char path[CGROUP_PATH_SIZE];
+
+  if (make_path(path, dir, NULL)) return -1;
+  return rmdir(path);
+}
+
+int cgroup_enable(const char* dir, const char* controllers)
+{
+  /* enable the space separated controllers for the children of dir. */
+  /* controllers are enabled one by one, so that one missing controller */
+  /* does not prevent the others. -1 if any failed. */
+
+  char buf[64];
+  const char* p = controllers;
+  size_t n;
+  int err = 0;
+
+  while (*p)
+  {
+    while (*p == ' ') ++p;
+    n = strcspn(p, " ");
+    if (n == 0) break ;
+    if ((n + 2) > sizeof(buf)) return -1;
+
+    buf[0] = '+';
+    memcpy(buf + 1, p, n);
+    buf[n + 1] = 0;
+    if (cgroup_write(dir, "cgroup.subtree_control", buf)) err = -1;
+
+    p += n;
+  }
+
+  return err;
+}
+
+int cgroup_attach(const char* dir, pid_t pid)
+{
+  /* move the whole process */
+
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%d", (int)pid);
+  return cgroup_write(dir, "cgroup.procs", buf);
+}
+
+int cgroup_attach_thread(const char* dir, pid_t tid)
+{
+  /* move one thread. dir must be a threaded group, in the same */
+  /* threaded subtree as the other threads of the process */
+
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%d", (int)tid);
+  return cgroup_write(dir, "cgroup.threads", buf);
+}
+
+int cgroup_self(char* dir, size_t size)
+{
+  /* the current group of the process, relative to the mount point. */
+  /* the unified hierarchy entry of /proc/self/cgroup is 0::/<path> */
+
+  char line[CGROUP_PATH_SIZE];
+  FILE* file;
+  size_t n;
+  int err = -1;
+
+  file = fopen("/proc/self/cgroup", "r");
+  if (file == NULL) return -1;
+
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    if (strncmp(line, "0::/", 4)) continue ;
+    n = strcspn(line + 4, "\n");
+    if (n >= size) break ;
+    memcpy(dir, line + 4, n);
+    dir[n] = 0;
+    err = 0;
+    break ;
+  }
+
+  fclose(file);
+
+  return err;
+}
@@ -0,0 +1,26 @@
+#ifndef CGROUP_H_INCLUDED
+#define CGROUP_H_INCLUDED
+
+
+/* minimal cgroup v2 helpers. paths are relative to the unified */
+/* hierarchy mount point, ie. "rtbench/cpu" for /sys/fs/cgroup/rtbench/cpu */
+
+
+#include <stddef.h>
+#include <sys/types.h>
+
+
+#define CGROUP_MOUNT "/sys/fs/cgroup"
+#define CGROUP_PATH_SIZE 256
+
+int cgroup_write(const char*, const char*, const char*);
+int cgroup_read(const char*, const char*, char*, size_t);
+int cgroup_create(const char*);
+int cgroup_destroy(const char*);
+int cgroup_enable(const char*, const char*);
+int cgroup_attach(const char*, pid_t);
+int cgroup_attach_thread(const char*, pid_t);
+int cgroup_self(char*, size_t);
+
+
+#endif /* CGROUP_H_INCLUDED */
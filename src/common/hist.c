@@ -0,0 +1,335 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "hist.h"
+
+
+/* the scans below work on blocks of HIST_BLOCK bins. the inner loops */
+/* have no dependency between iterations and are left to the compiler */
+/* vectorizer (-ftree-vectorize), so that the code stays portable */
+/* between the x86 and arm targets. */
+
+#define HIST_BLOCK 64
+
+#define HIST_MAGIC 0x54534948
+#define HIST_VERSION 1
+
+typedef struct hist_header
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t res_us;
+  uint32_t reserved;
+  uint64_t nbins;
+  uint64_t nnz;
+} hist_header_t;
+
+
+/* allocation */
+
+int hist_init(hist_t* hist, size_t nbins, uint32_t res_us)
+{
+  if ((nbins == 0) || (res_us == 0)) return -1;
+
+  hist->bins = malloc(nbins * sizeof(uint64_t));
+  if (hist->bins == NULL) return -1;
+
+  hist->nbins = nbins;
+  hist->res_us = res_us;
+  hist->is_extern = 0;
+  hist_clear(hist);
+
+  return 0;
+}
+
+int hist_init_with(hist_t* hist, uint64_t* bins, size_t nbins, uint32_t res_us)
+{
+  /* bins of nbins counters, ie. placed on a given numa node */
+
+  if ((bins == NULL) || (nbins == 0) || (res_us == 0)) return -1;
+
+  hist->bins = bins;
+  hist->nbins = nbins;
+  hist->res_us = res_us;
+  hist->is_extern = 1;
+  hist_clear(hist);
+
+  return 0;
+}
+
+void hist_fini(hist_t* hist)
+{
+  if (hist->is_extern == 0) free(hist->bins);
+  hist->bins = NULL;
+}
+
+void hist_clear(hist_t* hist)
+{
+  memset(hist->bins, 0, hist->nbins * sizeof(uint64_t));
+}
+
+
+/* arithmetic */
+
+static int is_compatible(const hist_t* a, const hist_t* b)
+{
+  return (a->nbins == b->nbins) && (a->res_us == b->res_us);
+}
+
+int hist_merge(hist_t* dst, const hist_t* src)
+{
+  uint64_t* __restrict__ d = dst->bins;
+  const uint64_t* __restrict__ s = src->bins;
+  size_t i;
+
+  if (is_compatible(dst, src) == 0) return -1;
+
+  for (i = 0; i != dst->nbins; ++i) d[i] += s[i];
+
+  return 0;
+}
+
+int hist_subtract(hist_t* dst, const hist_t* src)
+{
+  /* saturate at 0, so that subtracting an older snapshot of a */
+  /* histogram that has since been cleared does not wrap */
+
+  uint64_t* __restrict__ d = dst->bins;
+  const uint64_t* __restrict__ s = src->bins;
+  size_t i;
+
+  if (is_compatible(dst, src) == 0) return -1;
+
+  for (i = 0; i != dst->nbins; ++i) d[i] = (d[i] > s[i]) ? d[i] - s[i] : 0;
+
+  return 0;
+}
+
+int hist_rebin(hist_t* hist, size_t factor)
+{
+  /* coarsen in place: factor adjacent bins are summed into one */
+
+  size_t nbins;
+  size_t i;
+  size_t j;
+
+  if (factor == 0) return -1;
+  if (factor == 1) return 0;
+
+  nbins = (hist->nbins + factor - 1) / factor;
+
+  for (i = 0; i != nbins; ++i)
+  {
+    uint64_t sum = 0;
+    const size_t k = i * factor;
+    for (j = 0; (j != factor) && ((k + j) < hist->nbins); ++j)
+      sum += hist->bins[k + j];
+    hist->bins[i] = sum;
+  }
+
+  memset(hist->bins + nbins, 0, (hist->nbins - nbins) * sizeof(uint64_t));
+
+  hist->nbins = nbins;
+  hist->res_us *= (uint32_t)factor;
+
+  return 0;
+}
+
+
+/* statistics */
+
+static uint64_t sum_block(const uint64_t* p, size_t n)
+{
+  uint64_t sum = 0;
+  size_t i;
+  for (i = 0; i != n; ++i) sum += p[i];
+  return sum;
+}
+
+uint64_t hist_total(const hist_t* hist)
+{
+  return sum_block(hist->bins, hist->nbins);
+}
+
+int hist_percentiles
+(const hist_t* hist, const double* p, uint32_t* x, size_t n)
+{
+  /* p must be sorted in increasing order, 0 <= p[i] <= 100. */
+  /* the result is the smallest bin value whose cumulated count */
+  /* reaches the rank ceil(p / 100 * total). the scan skips whole */
+  /* blocks with one vectorized sum and only walks bins inside the */
+  /* block that contains the rank. */
+
+  const uint64_t total = hist_total(hist);
+  uint64_t cum = 0;
+  uint64_t rank;
+  size_t i = 0;
+  size_t j;
+  size_t k;
+
+  if (total == 0) return -1;
+
+  for (k = 0; k != n; ++k)
+  {
+    if ((p[k] < 0) || (p[k] > 100)) return -1;
+
+    rank = (uint64_t)ceil(p[k] / 100.0 * (double)total);
+    if (rank == 0) rank = 1;
+    if (rank > total) rank = total;
+
+    /* skip blocks */
+
+    while (1)
+    {
+      size_t nblock = hist->nbins - i;
+      uint64_t sum;
+
+      if (nblock > HIST_BLOCK) nblock = HIST_BLOCK;
+      if (nblock == 0) return -1;
+
+      sum = sum_block(hist->bins + i, nblock);
+      if ((cum + sum) >= rank) break ;
+
+      cum += sum;
+      i += nblock;
+    }
+
+    /* walk inside the block. cum and i are left at the block start */
+    /* so that the next percentile restarts from there. */
+
+    {
+      uint64_t c = cum;
+      for (j = i; (c + hist->bins[j]) < rank; ++j) c += hist->bins[j];
+      x[k] = (uint32_t)(j * hist->res_us);
+    }
+  }
+
+  return 0;
+}
+
+int hist_percentile(const hist_t* hist, double p, uint32_t* x)
+{
+  return hist_percentiles(hist, &p, x, 1);
+}
+
+int hist_moments(const hist_t* hist, double* mean, double* stddev)
+{
+  double n = 0;
+  double sum = 0;
+  double sum2 = 0;
+  double v;
+  size_t i;
+
+  for (i = 0; i != hist->nbins; ++i)
+  {
+    if (hist->bins[i] == 0) continue ;
+    v = (double)(i * hist->res_us);
+    n += (double)hist->bins[i];
+    sum += (double)hist->bins[i] * v;
+    sum2 += (double)hist->bins[i] * v * v;
+  }
+
+  if (n == 0) return -1;
+
+  *mean = sum / n;
+  v = sum2 / n - *mean * *mean;
+  *stddev = (v > 0) ? sqrt(v) : 0;
+
+  return 0;
+}
+
+
+/* serialization */
+
+int hist_save(const hist_t* hist, FILE* file)
+{
+  hist_header_t h;
+  uint64_t pair[2];
+  size_t i;
+
+  h.magic = HIST_MAGIC;
+  h.version = HIST_VERSION;
+  h.res_us = hist->res_us;
+  h.reserved = 0;
+  h.nbins = (uint64_t)hist->nbins;
+  h.nnz = 0;
+  for (i = 0; i != hist->nbins; ++i) h.nnz += (hist->bins[i] != 0);
+
+  if (fwrite(&h, sizeof(h), 1, file) != 1) return -1;
+
+  for (i = 0; i != hist->nbins; ++i)
+  {
+    if (hist->bins[i] == 0) continue ;
+    pair[0] = (uint64_t)i;
+    pair[1] = hist->bins[i];
+    if (fwrite(pair, sizeof(pair), 1, file) != 1) return -1;
+  }
+
+  return 0;
+}
+
+int hist_load(hist_t* hist, FILE* file)
+{
+  /* hist is initialized from the header, and must be finalized */
+  /* by the caller on success only */
+
+  hist_header_t h;
+  uint64_t pair[2];
+  uint64_t i;
+
+  if (fread(&h, sizeof(h), 1, file) != 1) goto on_error_0;
+  if ((h.magic != HIST_MAGIC) || (h.version != HIST_VERSION)) goto on_error_0;
+  if (hist_init(hist, (size_t)h.nbins, h.res_us)) goto on_error_0;
+
+  for (i = 0; i != h.nnz; ++i)
+  {
+    if (fread(pair, sizeof(pair), 1, file) != 1) goto on_error_1;
+    if (pair[0] >= h.nbins) goto on_error_1;
+    hist->bins[pair[0]] = pair[1];
+  }
+
+  return 0;
+
+ on_error_1:
+  hist_fini(hist);
+ on_error_0:
+  return -1;
+}
+
+int hist_print(const hist_t* hist, FILE* file)
+{
+  size_t i;
+
+  for (i = 0; i != hist->nbins; ++i)
+  {
+    if (hist->bins[i] == 0) continue ;
+    fprintf(file, "%zu %llu\n",
+	    i * hist->res_us, (unsigned long long)hist->bins[i]);
+  }
+
+  return 0;
+}
+
+int hist_import(hist_t* hist, FILE* file)
+{
+  /* hist must be initialized. counts are added to the existing */
+  /* ones, so that several dat files can be imported in one hist. */
+
+  char line[256];
+  unsigned long x;
+  unsigned long long n;
+  size_t i;
+
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    if ((line[0] == '#') || (line[0] == '\n')) continue ;
+    if (sscanf(line, "%lu %llu", &x, &n) != 2) return -1;
+    i = (size_t)(x / hist->res_us);
+    if (i >= hist->nbins) return -1;
+    hist->bins[i] += (uint64_t)n;
+  }
+
+  return 0;
+}
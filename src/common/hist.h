@@ -0,0 +1,58 @@
+#ifndef HIST_H_INCLUDED
+#define HIST_H_INCLUDED
+
+
+/* latency histogram arithmetic, shared by the stat and analysis tools */
+
+/* a histogram is an array of nbins counters, bin i counting the values */
+/* in [i * res_us, (i + 1) * res_us[. the text format is the one of the */
+/* dat directory: lines starting with '#' are comments, other lines are */
+/* '<value_us> <count>' pairs for nonzero bins. the binary format is a */
+/* header followed by (index, count) pairs for nonzero bins, in host */
+/* byte order. */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+
+typedef struct hist
+{
+  uint64_t* bins;
+  size_t nbins;
+  uint32_t res_us;
+  /* bins provided by the caller, not freed by hist_fini */
+  unsigned int is_extern;
+} hist_t;
+
+int hist_init(hist_t*, size_t, uint32_t);
+int hist_init_with(hist_t*, uint64_t*, size_t, uint32_t);
+void hist_fini(hist_t*);
+void hist_clear(hist_t*);
+
+/* realtime path: no allocation, no system call */
+static inline int hist_record(hist_t* hist, uint32_t x)
+{
+  const size_t i = (size_t)(x / hist->res_us);
+  if (i >= hist->nbins) return -1;
+  ++hist->bins[i];
+  return 0;
+}
+
+int hist_merge(hist_t*, const hist_t*);
+int hist_subtract(hist_t*, const hist_t*);
+int hist_rebin(hist_t*, size_t);
+
+uint64_t hist_total(const hist_t*);
+int hist_percentile(const hist_t*, double, uint32_t*);
+int hist_percentiles(const hist_t*, const double*, uint32_t*, size_t);
+int hist_moments(const hist_t*, double*, double*);
+
+int hist_save(const hist_t*, FILE*);
+int hist_load(hist_t*, FILE*);
+int hist_print(const hist_t*, FILE*);
+int hist_import(hist_t*, FILE*);
+
+
+#endif /* HIST_H_INCLUDED */
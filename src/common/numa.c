@@ -0,0 +1,83 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#include "numa.h"
+
+
+/* values of linux/mempolicy.h, not shipped by every toolchain */
+#define MPOL_BIND_ 2
+#define MPOL_MF_STRICT_ (1 << 0)
+#define MPOL_MF_MOVE_ (1 << 1)
+
+#define ULONG_BITS (8 * sizeof(unsigned long))
+#define MASK_SIZE (NUMA_MAX_NODES / ULONG_BITS)
+
+static int make_mask(unsigned long* mask, int node)
+{
+  if ((node < 0) || (node >= NUMA_MAX_NODES)) return -1;
+  memset(mask, 0, MASK_SIZE * sizeof(unsigned long));
+  mask[(size_t)node / ULONG_BITS] |= 1UL << ((size_t)node % ULONG_BITS);
+  return 0;
+}
+
+
+/* node of a cpu, from its sysfs node<n> link. -1 if the kernel has */
+/* no numa support */
+
+int numa_cpu_node(int cpu)
+{
+  char path[64];
+  struct dirent* de;
+  DIR* dir;
+  int node = -1;
+
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+  dir = opendir(path);
+  if (dir == NULL) return -1;
+
+  while ((de = readdir(dir)) != NULL)
+  {
+    if (strncmp(de->d_name, "node", 4)) continue ;
+    if ((de->d_name[4] < '0') || (de->d_name[4] > '9')) continue ;
+    node = atoi(de->d_name + 4);
+    break ;
+  }
+
+  closedir(dir);
+
+  return node;
+}
+
+
+/* bind the pages of a range to a node, moving those already faulted */
+
+int numa_bind_range(void* addr, size_t size, int node)
+{
+  unsigned long mask[MASK_SIZE];
+
+  if (make_mask(mask, node)) return -1;
+
+  /* the kernel takes maxnode as one more than the mask bits */
+  if (syscall(SYS_mbind, addr, size, MPOL_BIND_, mask, NUMA_MAX_NODES + 1,
+	      MPOL_MF_STRICT_ | MPOL_MF_MOVE_))
+    return -1;
+
+  return 0;
+}
+
+
+/* bind the future allocations of the calling thread to a node */
+
+int numa_bind_thread(int node)
+{
+  unsigned long mask[MASK_SIZE];
+
+  if (make_mask(mask, node)) return -1;
+  if (syscall(SYS_set_mempolicy, MPOL_BIND_, mask, NUMA_MAX_NODES + 1))
+    return -1;
+
+  return 0;
+}
@@ -0,0 +1,19 @@
+#ifndef NUMA_H_INCLUDED
+#define NUMA_H_INCLUDED
+
+
+/* minimal numa helpers, using the system calls and sysfs so that no */
+/* libnuma is needed. nodes are numbered as in /sys/devices/system/node */
+
+
+#include <stddef.h>
+
+
+#define NUMA_MAX_NODES 1024
+
+int numa_cpu_node(int);
+int numa_bind_range(void*, size_t, int);
+int numa_bind_thread(int);
+
+
+#endif /* NUMA_H_INCLUDED */
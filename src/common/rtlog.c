@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "rtlog.h"
+
+
+/* the ring is zero initialized: every slot is free for lap 0 */
+
+static rtlog_rec_t ring[RTLOG_SIZE];
+static volatile uint64_t head;
+static volatile uint64_t tail;
+static volatile size_t dropped;
+
+static FILE* file;
+static volatile unsigned int is_done;
+static pthread_t thread;
+
+
+/* producers */
+
+int rtlog_push
+(const char* f, int line, const char* fmt,
+ unsigned long long a, unsigned long long b)
+{
+  uint64_t pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+  rtlog_rec_t* rec;
+  uint64_t seq;
+  uint64_t lap;
+
+  while (1)
+  {
+    rec = &ring[pos % RTLOG_SIZE];
+    lap = 2 * (pos / RTLOG_SIZE);
+    seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+
+    if (seq == lap)
+    {
+      /* free slot, claim it. on failure pos is the current head */
+      if (__atomic_compare_exchange_n
+	  (&head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	break ;
+    }
+    else if (seq < lap)
+    {
+      /* not yet consumed from the previous lap: full */
+      __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+      return -1;
+    }
+    else
+    {
+      /* claimed by another producer */
+      pos = __atomic_load_n(&head, __ATOMIC_RELAXED);
+    }
+  }
+
+  rec->file = f;
+  rec->line = line;
+  rec->fmt = fmt;
+  rec->args[0] = a;
+  rec->args[1] = b;
+  __atomic_store_n(&rec->seq, lap + 1, __ATOMIC_RELEASE);
+
+  return 0;
+}
+
+
+/* consumer */
+
+static size_t drain(void)
+{
+  rtlog_rec_t* rec;
+  size_t n = 0;
+
+  while (1)
+  {
+    rec = &ring[tail % RTLOG_SIZE];
+    if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) !=
+	(2 * (tail / RTLOG_SIZE) + 1))
+      break ;
+
+    fprintf(file, "[!] %s,%d", rec->file, rec->line);
+    if (rec->fmt != NULL)
+    {
+      fputc(' ', file);
+      fprintf(file, rec->fmt, rec->args[0], rec->args[1]);
+    }
+    fputc('\n', file);
+
+    __atomic_store_n(&rec->seq, 2 * (tail / RTLOG_SIZE + 1), __ATOMIC_RELEASE);
+    __atomic_store_n(&tail, tail + 1, __ATOMIC_RELEASE);
+    ++n;
+  }
+
+  if (n) fflush(file);
+
+  return n;
+}
+
+static void* rtlog_main(void* args)
+{
+  while (is_done == 0)
+  {
+    if (drain() == 0) usleep(10000);
+  }
+
+  drain();
+
+  return NULL;
+}
+
+int rtlog_open(FILE* f)
+{
+  file = f;
+  is_done = 0;
+  if (pthread_create(&thread, NULL, rtlog_main, NULL)) return -1;
+  return 0;
+}
+
+void rtlog_close(void)
+{
+  is_done = 1;
+  pthread_join(thread, NULL);
+}
+
+void rtlog_flush(void)
+{
+  /* wait for the records pushed so far to be written, so that they */
+  /* do not interleave with the caller next output */
+
+  while (__atomic_load_n(&tail, __ATOMIC_ACQUIRE) !=
+	 __atomic_load_n(&head, __ATOMIC_ACQUIRE))
+    usleep(1000);
+}
+
+size_t rtlog_dropped(void)
+{
+  return __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,41 @@
+#ifndef RTLOG_H_INCLUDED
+#define RTLOG_H_INCLUDED
+
+
+/* realtime safe diagnostics. the realtime path pushes fixed size */
+/* records in a bounded lock free multi producer single consumer ring, */
+/* without system call, lock or allocation. a non realtime thread */
+/* formats and writes them. records are dropped and counted when the */
+/* ring is full. the ring is static, so records can be pushed before */
+/* rtlog_open, they are written once the thread runs. */
+
+/* the format strings and file names must be literals, their pointers */
+/* are stored in the records. arguments are printed with %llu or %llx. */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+
+#define RTLOG_SIZE 256
+
+typedef struct rtlog_rec
+{
+  /* 2 * lap for a free slot, 2 * lap + 1 for a written one */
+  volatile uint64_t seq;
+  const char* file;
+  const char* fmt;
+  unsigned long long args[2];
+  int line;
+} rtlog_rec_t;
+
+int rtlog_push
+(const char*, int, const char*, unsigned long long, unsigned long long);
+int rtlog_open(FILE*);
+void rtlog_close(void);
+void rtlog_flush(void);
+size_t rtlog_dropped(void);
+
+
+#endif /* RTLOG_H_INCLUDED */
@@ -0,0 +1,265 @@
+/* hist module tests, run on the build host: make test */
+
+/* percentiles are checked against a sort of the recorded values, with */
+/* sparse values so that the block skipping path is taken. the other */
+/* checks compare with a plain per bin computation. */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "hist.h"
+
+
+#define TEST_NBINS 10000
+#define TEST_NVALUES 20000
+
+static size_t nfailed;
+
+#define CHECK(__x) \
+do { if (!(__x)) { printf("[!] %s,%d: %s\n", __FILE__, __LINE__, #__x); ++nfailed; } } while (0)
+
+static uint32_t test_rand(uint32_t* x)
+{
+  /* xorshift32 */
+  *x ^= *x << 13;
+  *x ^= *x >> 17;
+  *x ^= *x << 5;
+  return *x;
+}
+
+static int cmp_u32(const void* a, const void* b)
+{
+  const uint32_t x = *(const uint32_t*)a;
+  const uint32_t y = *(const uint32_t*)b;
+  return (x > y) - (x < y);
+}
+
+static void fill(hist_t* h, uint32_t* values, size_t n, uint32_t seed)
+{
+  /* mostly low latencies, a sparse tail spanning many blocks */
+
+  uint32_t x = seed;
+  size_t i;
+
+  for (i = 0; i != n; ++i)
+  {
+    values[i] = 500 + test_rand(&x) % 200;
+    if ((test_rand(&x) % 100) == 0) values[i] = test_rand(&x) % TEST_NBINS;
+    hist_record(h, values[i]);
+  }
+}
+
+
+/* tests */
+
+static void test_percentiles(uint32_t res_us)
+{
+  static const double p[] = { 0, 1, 50, 90, 99, 99.9, 99.99, 100 };
+  const size_t np = sizeof(p) / sizeof(p[0]);
+  uint32_t values[TEST_NVALUES];
+  uint32_t x[sizeof(p) / sizeof(p[0])];
+  uint64_t rank;
+  uint32_t one;
+  hist_t h;
+  size_t i;
+
+  CHECK(hist_init(&h, TEST_NBINS / res_us, res_us) == 0);
+
+  /* empty */
+  CHECK(hist_percentiles(&h, p, x, np) == -1);
+
+  fill(&h, values, TEST_NVALUES, 0x2a2a2a2a + res_us);
+  qsort(values, TEST_NVALUES, sizeof(uint32_t), cmp_u32);
+
+  CHECK(hist_total(&h) == TEST_NVALUES);
+  CHECK(hist_percentiles(&h, p, x, np) == 0);
+
+  for (i = 0; i != np; ++i)
+  {
+    rank = (uint64_t)ceil(p[i] / 100.0 * (double)TEST_NVALUES);
+    if (rank == 0) rank = 1;
+    CHECK(x[i] == (values[rank - 1] / res_us) * res_us);
+
+    /* single and batched queries agree */
+    CHECK(hist_percentile(&h, p[i], &one) == 0);
+    CHECK(one == x[i]);
+  }
+
+  /* out of range */
+  one = 0;
+  CHECK(hist_percentile(&h, 100.1, &one) == -1);
+
+  hist_fini(&h);
+}
+
+static void test_rebin(void)
+{
+  const size_t factor = 7;
+  uint32_t values[TEST_NVALUES];
+  uint64_t ref[TEST_NBINS / 7 + 1];
+  hist_t h;
+  size_t nbins;
+  size_t i;
+
+  CHECK(hist_init(&h, TEST_NBINS, 1) == 0);
+  fill(&h, values, TEST_NVALUES, 1);
+
+  nbins = (TEST_NBINS + factor - 1) / factor;
+  memset(ref, 0, sizeof(ref));
+  for (i = 0; i != TEST_NBINS; ++i) ref[i / factor] += h.bins[i];
+
+  CHECK(hist_rebin(&h, 0) == -1);
+  CHECK(hist_rebin(&h, 1) == 0);
+  CHECK(h.nbins == TEST_NBINS);
+
+  CHECK(hist_rebin(&h, factor) == 0);
+  CHECK(h.nbins == nbins);
+  CHECK(h.res_us == factor);
+  for (i = 0; i != nbins; ++i) CHECK(h.bins[i] == ref[i]);
+  CHECK(hist_total(&h) == TEST_NVALUES);
+
+  /* the released tail is cleared, in the original allocation */
+  for (i = nbins; i != TEST_NBINS; ++i) CHECK(h.bins[i] == 0);
+
+  hist_fini(&h);
+}
+
+static void test_merge_subtract(void)
+{
+  uint32_t values[TEST_NVALUES];
+  uint64_t ref[TEST_NBINS];
+  hist_t a;
+  hist_t b;
+  hist_t c;
+  size_t i;
+
+  CHECK(hist_init(&a, TEST_NBINS, 1) == 0);
+  CHECK(hist_init(&b, TEST_NBINS, 1) == 0);
+  CHECK(hist_init(&c, TEST_NBINS / 2, 1) == 0);
+
+  fill(&a, values, TEST_NVALUES, 2);
+  fill(&b, values, TEST_NVALUES / 2, 3);
+
+  for (i = 0; i != TEST_NBINS; ++i) ref[i] = a.bins[i] + b.bins[i];
+  CHECK(hist_merge(&a, &b) == 0);
+  for (i = 0; i != TEST_NBINS; ++i) CHECK(a.bins[i] == ref[i]);
+
+  /* a - b is the original a */
+  for (i = 0; i != TEST_NBINS; ++i) ref[i] = a.bins[i] - b.bins[i];
+  CHECK(hist_subtract(&a, &b) == 0);
+  for (i = 0; i != TEST_NBINS; ++i) CHECK(a.bins[i] == ref[i]);
+
+  /* saturated at 0 */
+  hist_clear(&a);
+  hist_record(&a, 10);
+  CHECK(hist_subtract(&b, &a) == 0);
+  CHECK(hist_subtract(&a, &b) == 0);
+  for (i = 0; i != TEST_NBINS; ++i)
+    CHECK(a.bins[i] == ((i == 10) && (b.bins[10] == 0)));
+
+  /* incompatible geometries */
+  CHECK(hist_merge(&a, &c) == -1);
+  CHECK(hist_subtract(&a, &c) == -1);
+
+  hist_fini(&c);
+  hist_fini(&b);
+  hist_fini(&a);
+}
+
+static void test_save_load(void)
+{
+  uint32_t values[TEST_NVALUES];
+  hist_t a;
+  hist_t b;
+  FILE* file;
+
+  CHECK(hist_init(&a, TEST_NBINS, 2) == 0);
+  fill(&a, values, TEST_NVALUES, 4);
+
+  file = tmpfile();
+  CHECK(file != NULL);
+  if (file == NULL) goto on_error;
+
+  CHECK(hist_save(&a, file) == 0);
+  rewind(file);
+  CHECK(hist_load(&b, file) == 0);
+  fclose(file);
+
+  CHECK(b.nbins == a.nbins);
+  CHECK(b.res_us == a.res_us);
+  CHECK(memcmp(a.bins, b.bins, a.nbins * sizeof(uint64_t)) == 0);
+  hist_fini(&b);
+
+  /* a truncated file fails */
+  file = tmpfile();
+  CHECK(file != NULL);
+  if (file == NULL) goto on_error;
+  fwrite("HIST", 4, 1, file);
+  rewind(file);
+  CHECK(hist_load(&b, file) == -1);
+  fclose(file);
+
+ on_error:
+  hist_fini(&a);
+}
+
+static void test_print_import(void)
+{
+  uint32_t values[TEST_NVALUES];
+  hist_t a;
+  hist_t b;
+  FILE* file;
+  size_t i;
+
+  CHECK(hist_init(&a, TEST_NBINS, 5) == 0);
+  CHECK(hist_init(&b, TEST_NBINS, 5) == 0);
+  fill(&a, values, TEST_NVALUES / 5, 5);
+
+  file = tmpfile();
+  CHECK(file != NULL);
+  if (file == NULL) goto on_error;
+
+  /* comments are skipped, as in the dat files */
+  fprintf(file, "# machine: test\n\n");
+  CHECK(hist_print(&a, file) == 0);
+
+  /* imported twice, counts add up */
+  rewind(file);
+  CHECK(hist_import(&b, file) == 0);
+  rewind(file);
+  CHECK(hist_import(&b, file) == 0);
+  for (i = 0; i != TEST_NBINS; ++i) CHECK(b.bins[i] == 2 * a.bins[i]);
+
+  /* a value past the last bin fails */
+  rewind(file);
+  fprintf(file, "%u 1\n", TEST_NBINS * 5);
+  fflush(file);
+  rewind(file);
+  CHECK(hist_import(&b, file) == -1);
+
+  fclose(file);
+
+ on_error:
+  hist_fini(&b);
+  hist_fini(&a);
+}
+
+
+/* main */
+
+int main(int ac, char** av)
+{
+  test_percentiles(1);
+  test_percentiles(3);
+  test_rebin();
+  test_merge_subtract();
+  test_save_load();
+  test_print_import();
+
+  printf("# hist_test: %s\n", nfailed ? "failed" : "passed");
+
+  return nfailed ? -1 : 0;
+}
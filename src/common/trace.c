@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+
+
+/* writer */
+
+static size_t drain(trace_writer_t* w)
+{
+  /* write the ring content, at most in 2 contiguous parts */
+
+  const size_t head = __atomic_load_n(&w->head, __ATOMIC_ACQUIRE);
+  size_t tail = w->tail;
+  size_t n = 0;
+
+  while (tail != head)
+  {
+    const size_t i = tail & (w->size - 1);
+    size_t k = head - tail;
+    if (k > (w->size - i)) k = w->size - i;
+    fwrite(w->ring + i, sizeof(trace_rec_t), k, w->file);
+    tail += k;
+    n += k;
+    __atomic_store_n(&w->tail, tail, __ATOMIC_RELEASE);
+  }
+
+  return n;
+}
+
+static void* writer_main(void* args)
+{
+  trace_writer_t* const w = (trace_writer_t*)args;
+
+  while (w->is_done == 0)
+  {
+    if (drain(w) == 0) usleep(10000);
+  }
+
+  drain(w);
+
+  return NULL;
+}
+
+int trace_writer_open
+(trace_writer_t* w, const char* path, const trace_header_t* h, size_t size)
+{
+  trace_rec_t* const ring = malloc(size * sizeof(trace_rec_t));
+
+  if (ring == NULL) return -1;
+
+  if (trace_writer_open_with(w, path, h, size, ring))
+  {
+    free(ring);
+    return -1;
+  }
+
+  w->is_extern = 0;
+
+  return 0;
+}
+
+int trace_writer_open_with
+(trace_writer_t* w, const char* path, const trace_header_t* h, size_t size,
+ trace_rec_t* ring)
+{
+  /* ring of size records, size must be a power of 2 */
+
+  if ((size == 0) || (size & (size - 1))) goto on_error_0;
+
+  w->ring = ring;
+  w->is_extern = 1;
+
+  w->header = *h;
+  w->file = fopen(path, "w");
+  if (w->file == NULL) goto on_error_0;
+  if (fwrite(h, sizeof(trace_header_t), 1, w->file) != 1) goto on_error_1;
+
+  w->size = size;
+  w->head = 0;
+  w->tail = 0;
+  w->dropped = 0;
+  w->is_blocking = 0;
+  w->is_done = 0;
+
+  if (pthread_create(&w->thread, NULL, writer_main, w)) goto on_error_1;
+
+  return 0;
+
+ on_error_1:
+  fclose(w->file);
+ on_error_0:
+  return -1;
+}
+
+void trace_writer_close(trace_writer_t* w)
+{
+  w->is_done = 1;
+  pthread_join(w->thread, NULL);
+  if (fseek(w->file, 0, SEEK_SET) == 0)
+    fwrite(&w->header, sizeof(trace_header_t), 1, w->file);
+  fclose(w->file);
+  if (w->is_extern == 0) free(w->ring);
+}
+
+
+/* reader */
+
+int trace_map_open(trace_map_t* m, const char* path)
+{
+  struct stat st;
+  int fd;
+
+  fd = open(path, O_RDONLY);
+  if (fd == -1) goto on_error_0;
+  if (fstat(fd, &st)) goto on_error_1;
+  if ((size_t)st.st_size < sizeof(trace_header_t)) goto on_error_1;
+
+  m->size = (size_t)st.st_size;
+  m->addr = mmap(NULL, m->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (m->addr == MAP_FAILED) goto on_error_1;
+  madvise(m->addr, m->size, MADV_SEQUENTIAL);
+
+  m->header = (const trace_header_t*)m->addr;
+  if (m->header->magic != TRACE_MAGIC) goto on_error_2;
+  if (m->header->version != TRACE_VERSION) goto on_error_2;
+  if (m->header->fclk == 0) goto on_error_2;
+
+  m->recs = (const trace_rec_t*)(m->header + 1);
+  m->nrecs = (m->size - sizeof(trace_header_t)) / sizeof(trace_rec_t);
+
+  close(fd);
+
+  return 0;
+
+ on_error_2:
+  munmap(m->addr, m->size);
+ on_error_1:
+  close(fd);
+ on_error_0:
+  return -1;
+}
+
+void trace_map_close(trace_map_t* m)
+{
+  munmap(m->addr, m->size);
+}
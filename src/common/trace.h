@@ -0,0 +1,114 @@
+#ifndef TRACE_H_INCLUDED
+#define TRACE_H_INCLUDED
+
+
+/* per sample trace files. a trace is a header followed by one record */
+/* per uirq_wait return, holding the raw register values so that any */
+/* later analysis (or replay) sees exactly what the realtime task saw. */
+/* records are in host byte order. */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sched.h>
+#include <pthread.h>
+
+
+#define TRACE_MAGIC 0x43415254
+#define TRACE_VERSION 1
+
+typedef struct trace_header
+{
+  uint32_t magic;
+  uint32_t version;
+  /* REG_FCLK, in Hz */
+  uint32_t fclk;
+  /* requested IRQ generation frequency, in Hz */
+  uint32_t fgen;
+} trace_header_t;
+
+typedef struct trace_rec
+{
+  /* REG_START, REG_NOW and REG_COUNT, in REG_FCLK units */
+  uint32_t start;
+  uint32_t now;
+  uint32_t count;
+  /* uirq_wait mask, 0 for a timeout */
+  uint32_t mask;
+} trace_rec_t;
+
+static inline uint32_t trace_rec_ticks(const trace_rec_t* rec)
+{
+  /* modular arithmetic handles REG_NOW wrapping */
+  return rec->now - rec->start;
+}
+
+
+/* writer. the realtime task pushes records in a single producer single */
+/* consumer ring, a non realtime thread drains the ring to the file. */
+/* records are dropped and counted when the ring is full, unless the */
+/* writer is blocking (offline sources, where no sample must be lost */
+/* and the producer can wait for the consumer). the header is */
+/* written again at close, so that fields only known once the device is */
+/* configured (ie. fclk) can be set by the producer in the meantime. */
+
+typedef struct trace_writer
+{
+  trace_header_t header;
+  FILE* file;
+  trace_rec_t* ring;
+  size_t size;
+  volatile size_t head;
+  volatile size_t tail;
+  size_t dropped;
+  unsigned int is_blocking;
+  volatile unsigned int is_done;
+  /* ring provided by the caller, not freed at close */
+  unsigned int is_extern;
+  pthread_t thread;
+} trace_writer_t;
+
+int trace_writer_open
+(trace_writer_t*, const char*, const trace_header_t*, size_t);
+int trace_writer_open_with
+(trace_writer_t*, const char*, const trace_header_t*, size_t, trace_rec_t*);
+void trace_writer_close(trace_writer_t*);
+
+static inline int trace_writer_push(trace_writer_t* w, const trace_rec_t* rec)
+{
+  const size_t head = w->head;
+
+  while ((head - __atomic_load_n(&w->tail, __ATOMIC_ACQUIRE)) == w->size)
+  {
+    if (w->is_blocking == 0)
+    {
+      ++w->dropped;
+      return -1;
+    }
+    sched_yield();
+  }
+
+  w->ring[head & (w->size - 1)] = *rec;
+  __atomic_store_n(&w->head, head + 1, __ATOMIC_RELEASE);
+
+  return 0;
+}
+
+
+/* reader, maps the whole file */
+
+typedef struct trace_map
+{
+  void* addr;
+  size_t size;
+  const trace_header_t* header;
+  const trace_rec_t* recs;
+  size_t nrecs;
+} trace_map_t;
+
+int trace_map_open(trace_map_t*, const char*);
+void trace_map_close(trace_map_t*);
+
+
+#endif /* TRACE_H_INCLUDED */
@@ -0,0 +1,165 @@
+/* duty cycles and seeded chaos schedule of the antagonist classes */
+
+/* the parent process runs the schedule, the classes are forked once. */
+/* the intensity of a class is the duty cycle of its process, stopped */
+/* and continued with SIGSTOP and SIGCONT over a CHAOS_PERIOD_MS period. */
+/* without chaos, the intensities are the fixed -<class>_duty values. */
+/* with chaos, the schedule is a sequence of steps of random durations. */
+/* for each step and class, a random intensity is drawn: 0 (off) half */
+/* of the time, else 10 to 100 percent. the draws depend only on the */
+/* seed, so a schedule is replayed exactly by running again with the */
+/* same seed and the same classes. every step is logged, with its */
+/* time relative to the schedule start and its CLOCK_MONOTONIC time. */
+/* stat reports the CLOCK_MONOTONIC time of its IRQ generation start */
+/* (# clock: mono_start), IRQ <count> of a trace outlier is generated */
+/* about <count> / fgen later, which gives its step. */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <sys/types.h>
+#include "load.h"
+
+
+#define CHAOS_PERIOD_MS 100
+#define CHAOS_TICK_MS 5
+
+typedef struct chaos_class
+{
+  const char* name;
+  pid_t pid;
+  /* duty cycle, in percent */
+  unsigned int duty;
+  unsigned int is_stopped;
+} chaos_class_t;
+
+
+static uint64_t chaos_rand(uint64_t* x)
+{
+  /* xorshift64* */
+  *x ^= *x >> 12;
+  *x ^= *x << 25;
+  *x ^= *x >> 27;
+  return *x * 0x2545f4914f6cdd1dULL;
+}
+
+static void set_stopped(chaos_class_t* c, unsigned int is_stopped)
+{
+  if (c->is_stopped == is_stopped) return ;
+  kill(c->pid, is_stopped ? SIGSTOP : SIGCONT);
+  c->is_stopped = is_stopped;
+}
+
+
+/* entry point, returns when SIGINT is received. SIGINT must be blocked */
+
+int chaos_run
+(const cmdline_t* cmd, const char* const* names, const pid_t* pids, size_t n)
+{
+  chaos_class_t* classes;
+  uint64_t x;
+  uint64_t ms;
+  uint64_t range;
+  double t0;
+  double t;
+  double step_t;
+  double step_dt;
+  size_t nclasses;
+  size_t nsteps;
+  size_t i;
+  struct timespec ts;
+  sigset_t set;
+
+  if (cmd->chaos_min > cmd->chaos_max)
+  {
+    PERROR();
+    goto on_error_0;
+  }
+
+  classes = calloc(n ? n : 1, sizeof(chaos_class_t));
+  if (classes == NULL) goto on_error_0;
+
+  nclasses = 0;
+  for (i = 0; i != n; ++i)
+  {
+    if (pids[i] <= 0) continue ;
+    classes[nclasses].name = names[i];
+    classes[nclasses].pid = pids[i];
+    classes[nclasses].duty = cmd->duty[i];
+    classes[nclasses].is_stopped = 0;
+    ++nclasses;
+  }
+
+  /* xorshift must not be seeded with 0 */
+
+  x = cmd->chaos_seed ^ 0x9e3779b97f4a7c15ULL;
+  if (x == 0) x = 1;
+
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);
+
+  ts.tv_sec = 0;
+  ts.tv_nsec = CHAOS_TICK_MS * 1000000;
+
+  if (cmd->is_chaos)
+  {
+    printf("# chaos: seed=%llu period_ms=%u\n",
+	   (unsigned long long)cmd->chaos_seed, CHAOS_PERIOD_MS);
+    fflush(stdout);
+  }
+
+  t0 = load_time();
+  step_t = 0;
+  step_dt = 0;
+  nsteps = 0;
+  range = (uint64_t)(cmd->chaos_max - cmd->chaos_min) + 1;
+
+  while (1)
+  {
+    t = load_time() - t0;
+
+    /* next step. step times are planned, not observed, so that they */
+    /* do not drift */
+
+    if (cmd->is_chaos && (t >= (step_t + step_dt)))
+    {
+      step_t += step_dt;
+      step_dt = (double)(cmd->chaos_min + chaos_rand(&x) % range) / 1000.0;
+
+      printf("# chaos: t=%.3f mono=%.6f step=%zu duration=%.3f",
+	     step_t, t0 + step_t, nsteps, step_dt);
+      for (i = 0; i != nclasses; ++i)
+      {
+	classes[i].duty = 0;
+	if (chaos_rand(&x) & 1)
+	  classes[i].duty = 10 * (1 + chaos_rand(&x) % 10);
+	printf(" %s=%u", classes[i].name, classes[i].duty);
+      }
+      printf("\n");
+      fflush(stdout);
+
+      ++nsteps;
+    }
+
+    ms = (uint64_t)(t * 1000.0) % CHAOS_PERIOD_MS;
+    for (i = 0; i != nclasses; ++i)
+      set_stopped(&classes[i], ms >= classes[i].duty * CHAOS_PERIOD_MS / 100);
+
+    if (sigtimedwait(&set, NULL, &ts) == SIGINT) break ;
+  }
+
+  /* stopped processes would not handle SIGINT */
+
+  for (i = 0; i != nclasses; ++i) set_stopped(&classes[i], 0);
+
+  free(classes);
+
+  return 0;
+
+ on_error_0:
+  return -1;
+}
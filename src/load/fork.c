@@ -0,0 +1,154 @@
+/* process and thread creation storm antagonist */
+
+/* worker threads create short lived tasks at a controlled aggregate */
+/* rate, loading the scheduler load balancing, the mm setup of fork and */
+/* exec, and the exit teardown. modes, one per worker in turn: */
+/* exec: fork, exec fork_exec, wait */
+/* exit: fork, exit at once, wait */
+/* thread: create and join a thread */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "load.h"
+
+
+typedef struct fork_thread
+{
+  const cmdline_t* cmd;
+  unsigned int mode;
+  /* period between two creations, in ns, 0 for no pacing */
+  uint64_t period;
+  volatile uint64_t ntasks;
+} fork_thread_t;
+
+static const char* const mode_names[] = { "exec", "exit", "thread" };
+#define MODE_COUNT (sizeof(mode_names) / sizeof(mode_names[0]))
+
+
+static void* nop_main(void* args)
+{
+  return NULL;
+}
+
+static int create_task(const fork_thread_t* t)
+{
+  pthread_t thread;
+  pid_t pid;
+
+  if (t->mode == 2)
+  {
+    if (pthread_create(&thread, NULL, nop_main, NULL)) return -1;
+    pthread_join(thread, NULL);
+    return 0;
+  }
+
+  pid = fork();
+  if (pid == -1) return -1;
+
+  if (pid == 0)
+  {
+    if (t->mode == 0) execl(t->cmd->fork_exec, t->cmd->fork_exec, (char*)NULL);
+    _exit(0);
+  }
+
+  waitpid(pid, NULL, 0);
+
+  return 0;
+}
+
+static void* thread_main(void* args)
+{
+  fork_thread_t* const t = (fork_thread_t*)args;
+  struct timespec deadline;
+
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+  while (is_sigint == 0)
+  {
+    if (create_task(t))
+    {
+      PERROR();
+      break ;
+    }
+
+    ++t->ntasks;
+
+    /* absolute deadlines, so that the rate does not drift */
+
+    if (t->period == 0) continue ;
+    load_add_ns(&deadline, t->period);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+  }
+
+  return NULL;
+}
+
+
+/* report */
+
+static uint64_t get_count(const void* args)
+{
+  return ((const fork_thread_t*)args)->ntasks;
+}
+
+static void print_rate(void* args, double rate, double dt)
+{
+  const cmdline_t* const cmd = (const cmdline_t*)args;
+  printf("# fork: %s tasks/s=%.0f\n", cmd->fork_mode, rate);
+}
+
+
+/* entry point */
+
+void* fork_main(void* args)
+{
+  const cmdline_t* const cmd = (const cmdline_t*)args;
+  unsigned int modes[MODE_COUNT];
+  fork_thread_t* threads;
+  load_threads_t th;
+  size_t n;
+  size_t i;
+  int nmodes;
+
+  nmodes = load_get_modes(cmd->fork_mode, mode_names, MODE_COUNT, modes);
+  if ((nmodes <= 0) || (cmd->fork_threads == 0))
+  {
+    PERROR();
+    goto on_error_0;
+  }
+
+  n = cmd->fork_threads;
+  threads = calloc(n, sizeof(fork_thread_t));
+  if (threads == NULL) goto on_error_0;
+
+  for (i = 0; i != n; ++i)
+  {
+    threads[i].cmd = cmd;
+    threads[i].mode = modes[i % (size_t)nmodes];
+    threads[i].period = 0;
+    if (cmd->fork_rate)
+      threads[i].period = (uint64_t)n * 1000000000 / cmd->fork_rate;
+    threads[i].ntasks = 0;
+  }
+
+  if (load_threads_start(&th, threads, sizeof(fork_thread_t), n, thread_main))
+    goto on_error_1;
+
+  /* report the achieved creation rate */
+
+  load_threads_report(&th, get_count, print_rate, (void*)cmd);
+  load_threads_join(&th);
+
+ on_error_1:
+  free(threads);
+ on_error_0:
+  return NULL;
+}
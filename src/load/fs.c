@@ -0,0 +1,171 @@
+/* filesystem metadata churn antagonist */
+
+/* threads create, stat, rename and unlink batches of empty files in */
+/* private directories of each fs_dirs entry, typically a tmpfs and a */
+/* disk backed filesystem. this grows and shrinks the dentry and inode */
+/* caches, whose objects are freed through RCU callbacks, and keeps */
+/* the shrinkers busy. */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "load.h"
+
+
+#define FS_PATH_SIZE 512
+
+typedef struct fs_thread
+{
+  const cmdline_t* cmd;
+  char dir[FS_PATH_SIZE / 2];
+  volatile uint64_t nops;
+} fs_thread_t;
+
+
+static void make_path(char* buf, const char* dir, const char* name, size_t i)
+{
+  snprintf(buf, FS_PATH_SIZE, "%s/%s%zu", dir, name, i);
+}
+
+static void* thread_main(void* args)
+{
+  fs_thread_t* const t = (fs_thread_t*)args;
+  const size_t n = t->cmd->fs_files;
+  char path[FS_PATH_SIZE];
+  char new_path[FS_PATH_SIZE];
+  struct stat st;
+  size_t i;
+  int fd;
+
+  if (mkdir(t->dir, 0755))
+  {
+    PERROR();
+    return NULL;
+  }
+
+  while (is_sigint == 0)
+  {
+    for (i = 0; i != n; ++i)
+    {
+      make_path(path, t->dir, "a", i);
+      fd = open(path, O_CREAT | O_EXCL | O_WRONLY, 0644);
+      if (fd != -1) close(fd);
+    }
+
+    for (i = 0; i != n; ++i)
+    {
+      make_path(path, t->dir, "a", i);
+      stat(path, &st);
+    }
+
+    for (i = 0; i != n; ++i)
+    {
+      make_path(path, t->dir, "a", i);
+      make_path(new_path, t->dir, "b", i);
+      rename(path, new_path);
+    }
+
+    for (i = 0; i != n; ++i)
+    {
+      make_path(path, t->dir, "b", i);
+      unlink(path);
+    }
+
+    t->nops += 4 * n;
+  }
+
+  /* a batch may have been interrupted */
+
+  for (i = 0; i != n; ++i)
+  {
+    make_path(path, t->dir, "a", i);
+    unlink(path);
+    make_path(path, t->dir, "b", i);
+    unlink(path);
+  }
+
+  rmdir(t->dir);
+
+  return NULL;
+}
+
+
+/* report */
+
+static uint64_t get_count(const void* args)
+{
+  return ((const fs_thread_t*)args)->nops;
+}
+
+static void print_rate(void* args, double rate, double dt)
+{
+  printf("# fs: ops/s=%.0f\n", rate);
+}
+
+
+/* entry point */
+
+void* fs_main(void* args)
+{
+  const cmdline_t* const cmd = (const cmdline_t*)args;
+  fs_thread_t* threads;
+  load_threads_t th;
+  const char* s;
+  size_t ndirs;
+  size_t len;
+  size_t n;
+  size_t i;
+  size_t j;
+
+  if (cmd->fs_threads == 0)
+  {
+    PERROR();
+    goto on_error_0;
+  }
+
+  /* count the directories */
+
+  ndirs = 1;
+  for (s = cmd->fs_dirs; *s; ++s) ndirs += (*s == ',');
+
+  n = ndirs * cmd->fs_threads;
+  threads = calloc(n, sizeof(fs_thread_t));
+  if (threads == NULL) goto on_error_0;
+
+  /* one private directory per thread */
+
+  s = cmd->fs_dirs;
+  for (i = 0; i != ndirs; ++i)
+  {
+    len = strcspn(s, ",");
+    for (j = 0; j != cmd->fs_threads; ++j)
+    {
+      fs_thread_t* const t = &threads[i * cmd->fs_threads + j];
+      t->cmd = cmd;
+      snprintf(t->dir, sizeof(t->dir), "%.*s/rtbench_fs_%d_%zu",
+	       (int)len, s, (int)getpid(), j);
+    }
+    s += len;
+    if (*s == ',') ++s;
+  }
+
+  if (load_threads_start(&th, threads, sizeof(fs_thread_t), n, thread_main))
+    goto on_error_1;
+
+  /* report the metadata operations per second */
+
+  load_threads_report(&th, get_count, print_rate, NULL);
+  load_threads_join(&th);
+
+ on_error_1:
+  free(threads);
+ on_error_0:
+  return NULL;
+}
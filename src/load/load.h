@@ -0,0 +1,149 @@
+#ifndef LOAD_H_INCLUDED
+#define LOAD_H_INCLUDED
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+
+#define CONFIG_DEBUG 1
+#if (CONFIG_DEBUG == 1)
+#define PERROR() \
+do { printf("[!] %s,%d\n", __FILE__, __LINE__); } while (0)
+#else
+#define PERROR()
+#endif
+
+
+/* sigint catcher, set in every antagonist process */
+
+extern volatile unsigned int is_sigint;
+
+
+/* command line, passed to the antagonist entry points */
+
+#define LOAD_CLASS_MAX 16
+#define LOAD_KNOB_COUNT 5
+
+typedef struct cmdline
+{
+  /* classes to run */
+  unsigned int is_run[LOAD_CLASS_MAX];
+
+  /* cgroup root, or NULL */
+  const char* cgroup;
+  const char* knobs[LOAD_CLASS_MAX][LOAD_KNOB_COUNT];
+
+  /* duty cycle of each class, in percent */
+  unsigned int duty[LOAD_CLASS_MAX];
+
+  /* vm: memory pressure */
+  size_t vm_target;
+  /* default -vm_memhigh, half the target */
+  char vm_memhigh[24];
+  size_t vm_zram;
+  unsigned int vm_compact;
+
+  /* map: mmap and allocator churn */
+  const char* map_mode;
+  size_t map_threads;
+  size_t map_size;
+  const char* map_dir;
+
+  /* fork: task creation storm */
+  const char* fork_mode;
+  size_t fork_threads;
+  size_t fork_rate;
+  const char* fork_exec;
+
+  /* fs: filesystem metadata churn */
+  const char* fs_dirs;
+  size_t fs_threads;
+  size_t fs_files;
+
+  /* lock: lock contention */
+  const char* lock_type;
+  size_t lock_threads;
+  size_t lock_count;
+  size_t lock_cs;
+
+  /* share: false sharing */
+  const char* share_cpus;
+  unsigned int share_pad;
+
+  /* timer: high resolution timer storm */
+  const char* timer_type;
+  size_t timer_threads;
+  size_t timer_rate;
+
+  /* numa: local or remote memory bandwidth */
+  int numa_node;
+  size_t numa_threads;
+  size_t numa_size;
+
+  /* chaos: seeded random schedule of the classes */
+  unsigned int is_chaos;
+  uint64_t chaos_seed;
+  /* step duration bounds, in ms */
+  size_t chaos_min;
+  size_t chaos_max;
+} cmdline_t;
+
+
+/* monotonic time, in seconds, and absolute deadline increment */
+
+double load_time(void);
+void load_add_ns(struct timespec*, uint64_t);
+
+
+/* modes of an antagonist: "all" selects the n names, else one name */
+/* selects its index. returns the count of modes, -1 if unknown */
+
+int load_get_modes(const char*, const char* const*, size_t, unsigned int*);
+
+
+/* threads of an antagonist, one state of size bytes each. start */
+/* joins the already started threads and sets is_sigint on error. */
+/* report prints, once a second until sigint, the summed count rate */
+/* per second and the elapsed seconds */
+
+typedef struct load_threads
+{
+  void* states;
+  size_t size;
+  size_t n;
+  pthread_t* ids;
+} load_threads_t;
+
+void* load_threads_at(const load_threads_t*, size_t);
+int load_threads_start
+(load_threads_t*, void*, size_t, size_t, void* (*)(void*));
+void load_threads_report
+(const load_threads_t*, uint64_t (*)(const void*),
+ void (*)(void*, double, double), void*);
+void load_threads_join(load_threads_t*);
+
+
+/* duty cycle or chaos schedule of the forked classes, pids[i] <= 0 */
+/* if not running */
+
+int chaos_run(const cmdline_t*, const char* const*, const pid_t*, size_t);
+
+
+/* antagonist entry points, args is the cmdline_t */
+
+void* vm_main(void*);
+void* map_main(void*);
+void* fork_main(void*);
+void* fs_main(void*);
+void* lock_main(void*);
+void* share_main(void*);
+void* timer_main(void*);
+void* numa_main(void*);
+
+
+#endif /* LOAD_H_INCLUDED */
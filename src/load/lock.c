@@ -0,0 +1,266 @@
+/* lock contention antagonist */
+
+/* many threads take a few locks, spinning lock_cs iterations in the */
+/* critical section. lock types: */
+/* futex: a futex based mutex, counting its own futex system calls */
+/* mutex: pthread mutex */
+/* rwlock: pthread rwlock, one write lock out of 8 acquisitions */
+/* spin: pthread spinlock */
+/* sleeping locks contend on the kernel futex hash buckets and generate */
+/* wake up storms. pthread locks do not expose their futex calls, the */
+/* process context switches are reported instead. */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "load.h"
+
+
+/* futex mutex: 0 unlocked, 1 locked, 2 locked with waiters */
+
+typedef struct futex_lock
+{
+  volatile int32_t x;
+} futex_lock_t;
+
+static long sys_futex(volatile int32_t* addr, int op, int32_t val)
+{
+  return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+static void futex_lock(futex_lock_t* l, uint64_t* nsys)
+{
+  int32_t c = 0;
+
+  if (__atomic_compare_exchange_n
+      (&l->x, &c, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    return ;
+
+  if (c != 2) c = __atomic_exchange_n(&l->x, 2, __ATOMIC_ACQUIRE);
+  while (c != 0)
+  {
+    sys_futex(&l->x, FUTEX_WAIT_PRIVATE, 2);
+    ++*nsys;
+    c = __atomic_exchange_n(&l->x, 2, __ATOMIC_ACQUIRE);
+  }
+}
+
+static void futex_unlock(futex_lock_t* l, uint64_t* nsys)
+{
+  if (__atomic_fetch_sub(&l->x, 1, __ATOMIC_RELEASE) != 1)
+  {
+    __atomic_store_n(&l->x, 0, __ATOMIC_RELEASE);
+    sys_futex(&l->x, FUTEX_WAKE_PRIVATE, 1);
+    ++*nsys;
+  }
+}
+
+
+/* locks */
+
+enum { LOCK_FUTEX = 0, LOCK_MUTEX, LOCK_RWLOCK, LOCK_SPIN };
+
+static const char* const type_names[] = { "futex", "mutex", "rwlock", "spin" };
+#define TYPE_COUNT (sizeof(type_names) / sizeof(type_names[0]))
+
+typedef union lock
+{
+  futex_lock_t futex;
+  pthread_mutex_t mutex;
+  pthread_rwlock_t rwlock;
+  pthread_spinlock_t spin;
+} lock_t;
+
+typedef struct lock_thread
+{
+  const cmdline_t* cmd;
+  unsigned int type;
+  lock_t* locks;
+  size_t index;
+  volatile uint64_t nacqs;
+  volatile uint64_t nsys;
+} lock_thread_t;
+
+static void* thread_main(void* args)
+{
+  lock_thread_t* const t = (lock_thread_t*)args;
+  const size_t nlocks = t->cmd->lock_count;
+  const size_t ncs = t->cmd->lock_cs;
+  volatile size_t x = 0;
+  uint64_t nsys = 0;
+  size_t k = t->index;
+  size_t i;
+  lock_t* l;
+
+  while (is_sigint == 0)
+  {
+    l = &t->locks[k % nlocks];
+
+    switch (t->type)
+    {
+    case LOCK_FUTEX: futex_lock(&l->futex, &nsys); break ;
+    case LOCK_MUTEX: pthread_mutex_lock(&l->mutex); break ;
+    case LOCK_RWLOCK:
+      if ((k & 7) == 0) pthread_rwlock_wrlock(&l->rwlock);
+      else pthread_rwlock_rdlock(&l->rwlock);
+      break ;
+    default: pthread_spin_lock(&l->spin); break ;
+    }
+
+    for (i = 0; i != ncs; ++i) ++x;
+
+    switch (t->type)
+    {
+    case LOCK_FUTEX: futex_unlock(&l->futex, &nsys); break ;
+    case LOCK_MUTEX: pthread_mutex_unlock(&l->mutex); break ;
+    case LOCK_RWLOCK: pthread_rwlock_unlock(&l->rwlock); break ;
+    default: pthread_spin_unlock(&l->spin); break ;
+    }
+
+    ++k;
+    ++t->nacqs;
+    t->nsys = nsys;
+  }
+
+  return NULL;
+}
+
+static void init_lock(lock_t* l, unsigned int type)
+{
+  switch (type)
+  {
+  case LOCK_FUTEX: l->futex.x = 0; break ;
+  case LOCK_MUTEX: pthread_mutex_init(&l->mutex, NULL); break ;
+  case LOCK_RWLOCK: pthread_rwlock_init(&l->rwlock, NULL); break ;
+  default: pthread_spin_init(&l->spin, PTHREAD_PROCESS_PRIVATE); break ;
+  }
+}
+
+static void fini_lock(lock_t* l, unsigned int type)
+{
+  switch (type)
+  {
+  case LOCK_FUTEX: break ;
+  case LOCK_MUTEX: pthread_mutex_destroy(&l->mutex); break ;
+  case LOCK_RWLOCK: pthread_rwlock_destroy(&l->rwlock); break ;
+  default: pthread_spin_destroy(&l->spin); break ;
+  }
+}
+
+static uint64_t get_csw(void)
+{
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru)) return 0;
+  return (uint64_t)ru.ru_nvcsw + (uint64_t)ru.ru_nivcsw;
+}
+
+
+/* report */
+
+typedef struct lock_report
+{
+  const cmdline_t* cmd;
+  const load_threads_t* th;
+  unsigned int type;
+  uint64_t nsys;
+  uint64_t ncsw;
+} lock_report_t;
+
+static uint64_t get_count(const void* args)
+{
+  return ((const lock_thread_t*)args)->nacqs;
+}
+
+static void print_rate(void* args, double rate, double dt)
+{
+  /* futex calls and context switches along the acquisitions */
+
+  lock_report_t* const r = (lock_report_t*)args;
+  uint64_t nsys;
+  uint64_t ncsw;
+  size_t i;
+
+  ncsw = get_csw();
+  nsys = 0;
+  for (i = 0; i != r->th->n; ++i)
+    nsys += ((const lock_thread_t*)load_threads_at(r->th, i))->nsys;
+
+  printf("# lock: %s acquisitions/s=%.0f", r->cmd->lock_type, rate);
+  if (r->type == LOCK_FUTEX)
+    printf(" futex/s=%.0f", (double)(nsys - r->nsys) / dt);
+  printf(" csw/s=%.0f\n", (double)(ncsw - r->ncsw) / dt);
+
+  r->nsys = nsys;
+  r->ncsw = ncsw;
+}
+
+
+/* entry point */
+
+void* lock_main(void* args)
+{
+  const cmdline_t* const cmd = (const cmdline_t*)args;
+  lock_thread_t* threads;
+  lock_t* locks;
+  load_threads_t th;
+  lock_report_t r;
+  unsigned int type;
+  size_t n;
+  size_t i;
+
+  for (type = 0; type != TYPE_COUNT; ++type)
+  {
+    if (strcmp(cmd->lock_type, type_names[type]) == 0) break ;
+  }
+
+  if ((type == TYPE_COUNT) || (cmd->lock_count == 0))
+  {
+    PERROR();
+    goto on_error_0;
+  }
+
+  locks = malloc(cmd->lock_count * sizeof(lock_t));
+  if (locks == NULL) goto on_error_0;
+  for (i = 0; i != cmd->lock_count; ++i) init_lock(&locks[i], type);
+
+  n = cmd->lock_threads;
+  threads = calloc(n ? n : 1, sizeof(lock_thread_t));
+  if (threads == NULL) goto on_error_1;
+
+  for (i = 0; i != n; ++i)
+  {
+    threads[i].cmd = cmd;
+    threads[i].type = type;
+    threads[i].locks = locks;
+    threads[i].index = i;
+  }
+
+  if (load_threads_start(&th, threads, sizeof(lock_thread_t), n, thread_main))
+    goto on_error_2;
+
+  /* report acquisitions, futex calls and context switches per second */
+
+  r.cmd = cmd;
+  r.th = &th;
+  r.type = type;
+  r.nsys = 0;
+  r.ncsw = get_csw();
+  load_threads_report(&th, get_count, print_rate, &r);
+  load_threads_join(&th);
+
+ on_error_2:
+  free(threads);
+ on_error_1:
+  for (i = 0; i != cmd->lock_count; ++i) fini_lock(&locks[i], type);
+  free(locks);
+ on_error_0:
+  return NULL;
+}
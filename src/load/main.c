@@ -1,24 +1,36 @@
-/* load by creating cpu, network and memory bound threads */
+/* load by creating cpu, network, memory, vm, mm, task creation, */
+/* filesystem metadata, lock, cache coherence, timer and numa memory */
+/* bound antagonists */
 
+/* each antagonist class runs in its own process, so that it can be */
+/* placed in its own cgroup v2 group: memory and io are not threaded */
+/* controllers, thus threads of one process cannot be given different */
+/* memory.high or io.max limits. */
 
+
+#include <stdio.h>
 #include <unistd.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <time.h>
 #include <signal.h>
 #include <pthread.h>
 #include <string.h>
 #include <errno.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <sys/fcntl.h>
 #include <sys/socket.h>
 #include <sys/select.h>
 #include <netinet/in.h>
 #include <netdb.h>
+#include "cgroup.h"
+#include "load.h"
 
 
 /* sigint catcher */
 
-static volatile unsigned int is_sigint;
+volatile unsigned int is_sigint;
 
 static void on_sigint(int x)
 {
@@ -26,6 +38,120 @@ static void on_sigint(int x)
 }
 
 
+/* time */
+
+double load_time(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+void load_add_ns(struct timespec* ts, uint64_t ns)
+{
+  ns += (uint64_t)ts->tv_nsec;
+  ts->tv_sec += (time_t)(ns / 1000000000);
+  ts->tv_nsec = (long)(ns % 1000000000);
+}
+
+
+/* antagonist modes */
+
+int load_get_modes
+(const char* s, const char* const* names, size_t n, unsigned int* modes)
+{
+  /* all, or one mode name */
+
+  unsigned int i;
+
+  if (strcmp(s, "all") == 0)
+  {
+    for (i = 0; i != n; ++i) modes[i] = i;
+    return (int)n;
+  }
+
+  for (i = 0; i != n; ++i)
+  {
+    if (strcmp(s, names[i])) continue ;
+    modes[0] = i;
+    return 1;
+  }
+
+  return -1;
+}
+
+
+/* antagonist threads */
+
+void* load_threads_at(const load_threads_t* th, size_t i)
+{
+  return (uint8_t*)th->states + i * th->size;
+}
+
+int load_threads_start
+(load_threads_t* th, void* states, size_t size, size_t n, void* (*fn)(void*))
+{
+  size_t i;
+
+  th->states = states;
+  th->size = size;
+  th->n = n;
+  th->ids = calloc(n ? n : 1, sizeof(pthread_t));
+  if (th->ids == NULL) goto on_error_0;
+
+  for (i = 0; i != n; ++i)
+  {
+    if (pthread_create(&th->ids[i], NULL, fn, load_threads_at(th, i)))
+    {
+      PERROR();
+      th->n = i;
+      is_sigint = 1;
+      goto on_error_1;
+    }
+  }
+
+  return 0;
+
+ on_error_1:
+  load_threads_join(th);
+ on_error_0:
+  return -1;
+}
+
+void load_threads_report
+(const load_threads_t* th, uint64_t (*count)(const void*),
+ void (*print)(void*, double, double), void* args)
+{
+  /* sum the per thread counters once a second, until sigint */
+
+  uint64_t x[2] = { 0, 0 };
+  double t;
+  double tt;
+  size_t i;
+
+  t = load_time();
+  while (is_sigint == 0)
+  {
+    sleep(1);
+    tt = load_time();
+    x[1] = 0;
+    for (i = 0; i != th->n; ++i) x[1] += count(load_threads_at(th, i));
+    print(args, (double)(x[1] - x[0]) / (tt - t), tt - t);
+    fflush(stdout);
+    x[0] = x[1];
+    t = tt;
+  }
+}
+
+void load_threads_join(load_threads_t* th)
+{
+  size_t i;
+
+  for (i = 0; i != th->n; ++i) pthread_join(th->ids[i], NULL);
+  free(th->ids);
+}
+
+
 /* network bound thread */
 
 static void* net_main(void* args)
@@ -118,20 +244,479 @@ static void* mem_main(void* args)
 }
 
 
+/* antagonist classes */
+
+typedef struct load_class
+{
+  const char* name;
+  void* (*fn)(void*);
+} load_class_t;
+
+static const load_class_t classes[] =
+{
+  { "net", net_main },
+  { "cpu", cpu_main },
+  { "mem", mem_main },
+  { "vm", vm_main },
+  { "map", map_main },
+  { "fork", fork_main },
+  { "fs", fs_main },
+  { "lock", lock_main },
+  { "share", share_main },
+  { "timer", timer_main },
+  { "numa", numa_main }
+};
+
+#define CLASS_COUNT (sizeof(classes) / sizeof(classes[0]))
+
+typedef char class_count_check[(CLASS_COUNT <= LOAD_CLASS_MAX) ? 1 : -1];
+
+static const load_class_t* find_class(const char* s, size_t n)
+{
+  size_t i;
+
+  for (i = 0; i != CLASS_COUNT; ++i)
+  {
+    if ((strlen(classes[i].name) == n) && (strncmp(classes[i].name, s, n) == 0))
+      return &classes[i];
+  }
+
+  return NULL;
+}
+
+
+/* per class cgroup knobs, -<class>_<knob> <value> */
+
+static const char* const knob_names[LOAD_KNOB_COUNT] =
+{
+  "cpus",
+  "mems",
+  "cpumax",
+  "iomax",
+  "memhigh"
+};
+
+static const char* const knob_files[LOAD_KNOB_COUNT] =
+{
+  "cpuset.cpus",
+  "cpuset.mems",
+  "cpu.max",
+  "io.max",
+  "memory.high"
+};
+
+/* multi field values, where ',' stands for a space */
+static const unsigned int knob_is_fields[LOAD_KNOB_COUNT] =
+{
+  0,
+  0,
+  1,
+  1,
+  0
+};
+
+#define KNOB_COUNT LOAD_KNOB_COUNT
+#define KNOB_MEMHIGH 4
+
+
+/* command line parsing */
+
+static size_t get_size(const char* s)
+{
+  /* bytes, with an optional k, m or g binary suffix */
+
+  char* end;
+  size_t x = (size_t)strtoull(s, &end, 0);
+
+  switch (*end)
+  {
+  case 'k': case 'K': x <<= 10; break ;
+  case 'm': case 'M': x <<= 20; break ;
+  case 'g': case 'G': x <<= 30; break ;
+  default: break ;
+  }
+
+  return x;
+}
+
+static int get_run(cmdline_t* cmd, const char* s)
+{
+  const load_class_t* c;
+  size_t n;
+
+  memset(cmd->is_run, 0, sizeof(cmd->is_run));
+
+  while (*s)
+  {
+    n = strcspn(s, ",");
+    c = find_class(s, n);
+    if (c == NULL) return -1;
+    cmd->is_run[c - classes] = 1;
+    s += n;
+    if (*s == ',') ++s;
+  }
+
+  return 0;
+}
+
+static int get_knob(cmdline_t* cmd, const char* s, const char* value)
+{
+  /* s is <class>_<knob> */
+
+  const char* const sep = strchr(s, '_');
+  const load_class_t* c;
+  size_t i;
+
+  if (sep == NULL) return -1;
+  c = find_class(s, (size_t)(sep - s));
+  if (c == NULL) return -1;
+
+  /* not a cgroup knob, applied by stopping and continuing the class */
+  if (strcmp(sep + 1, "duty") == 0)
+  {
+    cmd->duty[c - classes] = (unsigned int)atoi(value);
+    return (cmd->duty[c - classes] > 100) ? -1 : 0;
+  }
+
+  for (i = 0; i != KNOB_COUNT; ++i)
+  {
+    if (strcmp(knob_names[i], sep + 1)) continue ;
+    cmd->knobs[c - classes][i] = value;
+    if (cmd->cgroup == NULL) cmd->cgroup = "rtbench_load";
+    return 0;
+  }
+
+  return -1;
+}
+
+static int get_cmdline(cmdline_t* cmd, size_t ac, char** av)
+{
+  /* -run <class,...>: antagonists to run, default net,cpu,mem */
+  /* -cgroup <name>: cgroup v2 group created under the root, one child */
+  /* group per class. implied by any knob, default rtbench_load. */
+  /* -<class>_cpus <list>: cpuset.cpus */
+  /* -<class>_mems <list>: cpuset.mems */
+  /* -<class>_cpumax '<quota> <period>': cpu.max bandwidth */
+  /* -<class>_iomax '<maj:min> <key=value> ...': io.max */
+  /* the cpumax and iomax fields may be separated by ',' instead of */
+  /* spaces, ie. -cpu_cpumax 50000,100000, so that the options survive */
+  /* the word splitting of the run scripts */
+  /* -<class>_memhigh <bytes>: memory.high */
+  /* -<class>_duty <percent>: running time ratio, default 100 */
+  /* -vm_target <bytes>: memory filled by vm, default 1g. without */
+  /* -vm_memhigh, vm runs in its group with half the target as limit */
+  /* -vm_zram <bytes>: swap on a zram0 device of this size */
+  /* -vm_compact <0|1>: also trigger compaction every second */
+  /* -map_mode <anon|file|thp|malloc|all>: map churn, default all */
+  /* -map_threads <count>: map threads sharing the mm, default 4 */
+  /* -map_size <bytes>: size of a mapping, default 16m */
+  /* -map_dir <path>: directory of the mapped file, default /tmp */
+  /* -fork_mode <exec|exit|thread|all>: task creation, default all */
+  /* -fork_threads <count>: creating threads, default 3 */
+  /* -fork_rate <count>: tasks per second, 0 is unpaced, default 1000 */
+  /* -fork_exec <path>: program run by exec, default /bin/true */
+  /* -fs_dirs <dir,...>: churned filesystems, default /dev/shm,/tmp */
+  /* -fs_threads <count>: threads per directory, default 1 */
+  /* -fs_files <count>: files per batch, default 1000 */
+  /* -lock_type <futex|mutex|rwlock|spin>: contended lock, default mutex */
+  /* -lock_threads <count>: contending threads, default 8 */
+  /* -lock_count <count>: number of locks, default 2 */
+  /* -lock_cs <count>: critical section iterations, default 100 */
+  /* -share_cpus <cpu,...>: cores sharing a line, 2 to 8, default 0,1 */
+  /* -share_pad <0|1>: one line per counter, the control, default 0 */
+  /* -timer_type <timerfd|nanosleep|posix|all>: timers, default all */
+  /* -timer_threads <count>: timer threads, default 4 */
+  /* -timer_rate <count>: expirations per second, default 100000 */
+  /* -numa_node <node>: node of the streamed memory, -1 is the node of */
+  /* the first touch, default -1. the cpus are set by -numa_cpus. */
+  /* -numa_threads <count>: streaming threads, default 4 */
+  /* -numa_size <bytes>: buffer per thread, default 256m */
+  /* -chaos <seed>: seeded random schedule of the classes, whose pool */
+  /* defaults to net,cpu,mem,map,fs,timer in this mode */
+  /* -chaos_min <ms>: minimum step duration, default 1000 */
+  /* -chaos_max <ms>: maximum step duration, default 10000 */
+
+  const load_class_t* c;
+  unsigned int is_run_set = 0;
+  size_t i;
+
+  if (ac & 1) goto on_error;
+
+  memset(cmd, 0, sizeof(cmdline_t));
+  get_run(cmd, "net,cpu,mem");
+  cmd->vm_target = (size_t)1 << 30;
+  cmd->map_mode = "all";
+  cmd->map_threads = 4;
+  cmd->map_size = (size_t)16 << 20;
+  cmd->map_dir = "/tmp";
+  cmd->fork_mode = "all";
+  cmd->fork_threads = 3;
+  cmd->fork_rate = 1000;
+  cmd->fork_exec = "/bin/true";
+  cmd->fs_dirs = "/dev/shm,/tmp";
+  cmd->fs_threads = 1;
+  cmd->fs_files = 1000;
+  cmd->lock_type = "mutex";
+  cmd->lock_threads = 8;
+  cmd->lock_count = 2;
+  cmd->lock_cs = 100;
+  cmd->share_cpus = "0,1";
+  cmd->timer_type = "all";
+  cmd->timer_threads = 4;
+  cmd->timer_rate = 100000;
+  cmd->numa_node = -1;
+  cmd->numa_threads = 4;
+  cmd->numa_size = (size_t)256 << 20;
+  for (i = 0; i != LOAD_CLASS_MAX; ++i) cmd->duty[i] = 100;
+  cmd->chaos_min = 1000;
+  cmd->chaos_max = 10000;
+
+  for (i = 0; i != ac; i += 2)
+  {
+    if (av[i][0] != '-') goto on_error;
+    if (strcmp(av[i], "-run") == 0)
+    {
+      if (get_run(cmd, av[i + 1])) goto on_error;
+      is_run_set = 1;
+    }
+    else if (strcmp(av[i], "-cgroup") == 0) cmd->cgroup = av[i + 1];
+    else if (strcmp(av[i], "-vm_target") == 0)
+      cmd->vm_target = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-vm_zram") == 0) cmd->vm_zram = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-vm_compact") == 0)
+      cmd->vm_compact = (unsigned int)atoi(av[i + 1]);
+    else if (strcmp(av[i], "-map_mode") == 0) cmd->map_mode = av[i + 1];
+    else if (strcmp(av[i], "-map_threads") == 0)
+      cmd->map_threads = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-map_size") == 0)
+      cmd->map_size = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-map_dir") == 0) cmd->map_dir = av[i + 1];
+    else if (strcmp(av[i], "-fork_mode") == 0) cmd->fork_mode = av[i + 1];
+    else if (strcmp(av[i], "-fork_threads") == 0)
+      cmd->fork_threads = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-fork_rate") == 0)
+      cmd->fork_rate = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-fork_exec") == 0) cmd->fork_exec = av[i + 1];
+    else if (strcmp(av[i], "-fs_dirs") == 0) cmd->fs_dirs = av[i + 1];
+    else if (strcmp(av[i], "-fs_threads") == 0)
+      cmd->fs_threads = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-fs_files") == 0)
+      cmd->fs_files = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-lock_type") == 0) cmd->lock_type = av[i + 1];
+    else if (strcmp(av[i], "-lock_threads") == 0)
+      cmd->lock_threads = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-lock_count") == 0)
+      cmd->lock_count = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-lock_cs") == 0) cmd->lock_cs = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-share_cpus") == 0) cmd->share_cpus = av[i + 1];
+    else if (strcmp(av[i], "-share_pad") == 0)
+      cmd->share_pad = (unsigned int)atoi(av[i + 1]);
+    else if (strcmp(av[i], "-timer_type") == 0) cmd->timer_type = av[i + 1];
+    else if (strcmp(av[i], "-timer_threads") == 0)
+      cmd->timer_threads = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-timer_rate") == 0)
+      cmd->timer_rate = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-numa_node") == 0) cmd->numa_node = atoi(av[i + 1]);
+    else if (strcmp(av[i], "-numa_threads") == 0)
+      cmd->numa_threads = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-numa_size") == 0)
+      cmd->numa_size = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-chaos") == 0)
+    {
+      cmd->is_chaos = 1;
+      cmd->chaos_seed = (uint64_t)strtoull(av[i + 1], NULL, 0);
+    }
+    else if (strcmp(av[i], "-chaos_min") == 0)
+      cmd->chaos_min = get_size(av[i + 1]);
+    else if (strcmp(av[i], "-chaos_max") == 0)
+      cmd->chaos_max = get_size(av[i + 1]);
+    else if (get_knob(cmd, av[i] + 1, av[i + 1])) goto on_error;
+  }
+
+  /* storage, ipi and timer interference in the chaos pool */
+
+  if (cmd->is_chaos && (is_run_set == 0))
+    get_run(cmd, "net,cpu,mem,map,fs,timer");
+
+  /* without a memory.high below its target, vm would only push the */
+  /* other groups out of memory, or get killed */
+
+  c = find_class("vm", 2);
+  i = (size_t)(c - classes);
+  if (cmd->is_run[i] && (cmd->knobs[i][KNOB_MEMHIGH] == NULL))
+  {
+    snprintf(cmd->vm_memhigh, sizeof(cmd->vm_memhigh), "%zu",
+	     cmd->vm_target / 2);
+    if (get_knob(cmd, "vm_memhigh", cmd->vm_memhigh)) goto on_error;
+  }
+
+  return 0;
+ on_error:
+  return -1;
+}
+
+
+/* cgroup setup */
+
+static int get_class_cgroup(char* buf, const cmdline_t* cmd, size_t i)
+{
+  const int n = snprintf
+    (buf, CGROUP_PATH_SIZE, "%s/%s", cmd->cgroup, classes[i].name);
+  return ((n < 0) || (n >= CGROUP_PATH_SIZE)) ? -1 : 0;
+}
+
+static void destroy_cgroups(const cmdline_t* cmd)
+{
+  char path[CGROUP_PATH_SIZE];
+  size_t i;
+
+  for (i = 0; i != CLASS_COUNT; ++i)
+  {
+    if (cmd->is_run[i] == 0) continue ;
+    if (get_class_cgroup(path, cmd, i)) continue ;
+    cgroup_destroy(path);
+  }
+
+  cgroup_destroy(cmd->cgroup);
+}
+
+static int create_cgroups(const cmdline_t* cmd)
+{
+  static const char* const controllers = "cpuset cpu io memory";
+  char path[CGROUP_PATH_SIZE];
+  char value[256];
+  size_t i;
+  size_t j;
+  size_t k;
+
+  /* controllers not available are reported by the knob writes */
+
+  cgroup_enable("", controllers);
+  if (cgroup_create(cmd->cgroup)) goto on_error;
+  cgroup_enable(cmd->cgroup, controllers);
+
+  for (i = 0; i != CLASS_COUNT; ++i)
+  {
+    if (cmd->is_run[i] == 0) continue ;
+    if (get_class_cgroup(path, cmd, i)) goto on_error;
+    if (cgroup_create(path)) goto on_error;
+
+    for (j = 0; j != KNOB_COUNT; ++j)
+    {
+      if (cmd->knobs[i][j] == NULL) continue ;
+
+      k = strlen(cmd->knobs[i][j]);
+      if (k >= sizeof(value)) goto on_error;
+      memcpy(value, cmd->knobs[i][j], k + 1);
+      for (k = 0; knob_is_fields[j] && value[k]; ++k)
+      {
+	if (value[k] == ',') value[k] = ' ';
+      }
+
+      if (cgroup_write(path, knob_files[j], value))
+      {
+	printf("[!] %s/%s\n", path, knob_files[j]);
+	goto on_error;
+      }
+    }
+  }
+
+  return 0;
+
+ on_error:
+  destroy_cgroups(cmd);
+  return -1;
+}
+
+
 /* main */
 
 int main(int ac, char** av)
 {
   size_t i;
-  pthread_t t[3];
-  void* (*f[3])(void*) = { net_main, cpu_main, mem_main };
-  const size_t n = sizeof(t) / sizeof(t[0]);
+  cmdline_t cmd;
+  pid_t pids[CLASS_COUNT];
+  const char* names[CLASS_COUNT];
+  unsigned int is_duty;
+  char path[CGROUP_PATH_SIZE];
+  sigset_t set;
+  sigset_t old_set;
+  int err = -1;
+
+  if (get_cmdline(&cmd, (size_t)ac - 1, av + 1)) goto on_error_0;
+
+  if (cmd.cgroup != NULL)
+  {
+    if (create_cgroups(&cmd))
+    {
+      PERROR();
+      goto on_error_0;
+    }
+  }
+
+  /* block SIGINT until the parent waits for it, so that it cannot be */
+  /* lost between the children start and sigsuspend */
 
   is_sigint = 0;
   signal(SIGINT, on_sigint);
+  sigemptyset(&set);
+  sigaddset(&set, SIGINT);
+  sigprocmask(SIG_BLOCK, &set, &old_set);
 
-  for (i = 0; i != n; ++i) pthread_create(&t[i], NULL, f[i], NULL);
-  for (i = 0; i != n; ++i) pthread_join(t[i], NULL);
+  for (i = 0; i != CLASS_COUNT; ++i) pids[i] = -1;
 
-  return 0;
+  for (i = 0; i != CLASS_COUNT; ++i)
+  {
+    if (cmd.is_run[i] == 0) continue ;
+
+    pids[i] = fork();
+    if (pids[i] == -1)
+    {
+      PERROR();
+      goto on_error_1;
+    }
+
+    if (pids[i] == 0)
+    {
+      if (cmd.cgroup != NULL)
+      {
+	if (get_class_cgroup(path, &cmd, i) || cgroup_attach(path, getpid()))
+	{
+	  PERROR();
+	  _exit(-1);
+	}
+      }
+
+      sigprocmask(SIG_SETMASK, &old_set, NULL);
+      classes[i].fn(&cmd);
+      _exit(0);
+    }
+  }
+
+  is_duty = cmd.is_chaos;
+  for (i = 0; i != CLASS_COUNT; ++i)
+    is_duty |= (pids[i] > 0) && (cmd.duty[i] != 100);
+
+  if (is_duty)
+  {
+    for (i = 0; i != CLASS_COUNT; ++i) names[i] = classes[i].name;
+    if (chaos_run(&cmd, names, pids, CLASS_COUNT)) goto on_error_1;
+    is_sigint = 1;
+  }
+
+  while (is_sigint == 0) sigsuspend(&old_set);
+
+  err = 0;
+
+ on_error_1:
+  for (i = 0; i != CLASS_COUNT; ++i)
+  {
+    if (pids[i] <= 0) continue ;
+    kill(pids[i], SIGINT);
+    waitpid(pids[i], NULL, 0);
+  }
+  sigprocmask(SIG_SETMASK, &old_set, NULL);
+  if (cmd.cgroup != NULL) destroy_cgroups(&cmd);
+ on_error_0:
+  return err;
 }
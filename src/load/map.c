@@ -0,0 +1,250 @@
+/* page fault, mmap churn and transparent huge page antagonist */
+
+/* several threads of one process map, fault in and unmap regions, so */
+/* that they contend on the mm locks and the page allocator zone locks, */
+/* and every munmap of a multithreaded mm sends TLB shootdown IPIs. */
+/* modes, one per thread in turn: */
+/* anon: anonymous private regions */
+/* file: shared mappings of an unlinked temporary file */
+/* thp: huge page advised regions, sparsely faulted and kept alive for */
+/* a while so that khugepaged collapses them, which needs compaction */
+/* malloc: allocator churn of mixed sizes, trimmed back to the kernel */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include "load.h"
+
+
+#define HPAGE_SIZE (2 * 1024 * 1024)
+
+/* thp regions alive at a time, per thread */
+#define THP_LIVE 16
+
+/* malloc pool */
+#define POOL_SIZE 1024
+#define POOL_MAX_ALLOC (256 * 1024)
+
+typedef struct map_thread
+{
+  const cmdline_t* cmd;
+  unsigned int mode;
+  volatile uint64_t nops;
+} map_thread_t;
+
+static const char* const mode_names[] = { "anon", "file", "thp", "malloc" };
+#define MODE_COUNT (sizeof(mode_names) / sizeof(mode_names[0]))
+
+
+static void touch(uint8_t* p, size_t n, size_t step)
+{
+  size_t i;
+  for (i = 0; i < n; i += step) p[i] = (uint8_t)i;
+}
+
+static void anon_loop(map_thread_t* t, size_t size, size_t page_size)
+{
+  uint8_t* p;
+
+  while (is_sigint == 0)
+  {
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) break ;
+    touch(p, size, page_size);
+    munmap(p, size);
+    ++t->nops;
+  }
+}
+
+static void file_loop(map_thread_t* t, size_t size, size_t page_size)
+{
+  char path[256];
+  uint8_t* p;
+  int fd;
+
+  snprintf(path, sizeof(path), "%s/rtbench_map_XXXXXX", t->cmd->map_dir);
+  fd = mkstemp(path);
+  if (fd == -1)
+  {
+    PERROR();
+    return ;
+  }
+  unlink(path);
+
+  if (ftruncate(fd, (off_t)size)) goto on_error;
+
+  while (is_sigint == 0)
+  {
+    p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) break ;
+    touch(p, size, page_size);
+    munmap(p, size);
+    ++t->nops;
+  }
+
+ on_error:
+  close(fd);
+}
+
+static void thp_loop(map_thread_t* t, size_t size, size_t page_size)
+{
+  /* regions are over allocated to be aligned on huge pages. one small */
+  /* page out of 8 is faulted in: khugepaged collapses such regions */
+  /* (max_ptes_none allows it by default), or MADV_COLLAPSE does. */
+
+  const size_t hsize = ((size + HPAGE_SIZE - 1) / HPAGE_SIZE) * HPAGE_SIZE;
+  const size_t msize = hsize + HPAGE_SIZE;
+  uint8_t* live[THP_LIVE];
+  uint8_t* p;
+  uint8_t* q;
+  size_t i = 0;
+
+  memset(live, 0, sizeof(live));
+
+  while (is_sigint == 0)
+  {
+    if (live[i] != NULL) munmap(live[i], msize);
+    live[i] = NULL;
+
+    p = mmap(NULL, msize, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) break ;
+    live[i] = p;
+
+    q = (uint8_t*)
+      (((uintptr_t)p + HPAGE_SIZE - 1) & ~(uintptr_t)(HPAGE_SIZE - 1));
+    madvise(q, hsize, MADV_HUGEPAGE);
+    touch(q, hsize, 8 * page_size);
+#ifdef MADV_COLLAPSE
+    madvise(q, hsize, MADV_COLLAPSE);
+#endif
+
+    ++t->nops;
+    i = (i + 1) % THP_LIVE;
+  }
+
+  for (i = 0; i != THP_LIVE; ++i)
+  {
+    if (live[i] != NULL) munmap(live[i], msize);
+  }
+}
+
+static void malloc_loop(map_thread_t* t)
+{
+  /* sizes span the brk heap and the mmap threshold */
+
+  void* pool[POOL_SIZE];
+  uint32_t x = 0x2a2a2a2a + (uint32_t)t->mode;
+  size_t n;
+  size_t i;
+
+  memset(pool, 0, sizeof(pool));
+
+  while (is_sigint == 0)
+  {
+    /* xorshift32 */
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    i = x % POOL_SIZE;
+    free(pool[i]);
+
+    n = (size_t)1 << (4 + (x >> 8) % 15);
+    if (n > POOL_MAX_ALLOC) n = POOL_MAX_ALLOC;
+    pool[i] = malloc(n);
+    if (pool[i] != NULL) memset(pool[i], 0x2a, n);
+
+    if ((++t->nops & 0xffff) == 0)
+    {
+#ifdef __GLIBC__
+      malloc_trim(0);
+#endif
+    }
+  }
+
+  for (i = 0; i != POOL_SIZE; ++i) free(pool[i]);
+}
+
+static void* thread_main(void* args)
+{
+  map_thread_t* const t = (map_thread_t*)args;
+  const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  const size_t size = t->cmd->map_size;
+
+  switch (t->mode)
+  {
+  case 0: anon_loop(t, size, page_size); break ;
+  case 1: file_loop(t, size, page_size); break ;
+  case 2: thp_loop(t, size, page_size); break ;
+  default: malloc_loop(t); break ;
+  }
+
+  return NULL;
+}
+
+
+/* report */
+
+static uint64_t get_count(const void* args)
+{
+  return ((const map_thread_t*)args)->nops;
+}
+
+static void print_rate(void* args, double rate, double dt)
+{
+  const cmdline_t* const cmd = (const cmdline_t*)args;
+  printf("# map: %s cycles/s=%.0f\n", cmd->map_mode, rate);
+}
+
+
+/* entry point */
+
+void* map_main(void* args)
+{
+  const cmdline_t* const cmd = (const cmdline_t*)args;
+  unsigned int modes[MODE_COUNT];
+  map_thread_t* threads;
+  load_threads_t th;
+  size_t n;
+  size_t i;
+  int nmodes;
+
+  nmodes = load_get_modes(cmd->map_mode, mode_names, MODE_COUNT, modes);
+  if (nmodes <= 0)
+  {
+    PERROR();
+    goto on_error_0;
+  }
+
+  n = cmd->map_threads;
+  threads = calloc(n, sizeof(map_thread_t));
+  if (threads == NULL) goto on_error_0;
+
+  for (i = 0; i != n; ++i)
+  {
+    threads[i].cmd = cmd;
+    threads[i].mode = modes[i % (size_t)nmodes];
+    threads[i].nops = 0;
+  }
+
+  if (load_threads_start(&th, threads, sizeof(map_thread_t), n, thread_main))
+    goto on_error_1;
+
+  /* report the map or allocation cycles per second */
+
+  load_threads_report(&th, get_count, print_rate, (void*)cmd);
+  load_threads_join(&th);
+
+ on_error_1:
+  free(threads);
+ on_error_0:
+  return NULL;
+}
@@ -0,0 +1,119 @@
+/* local or remote memory bandwidth antagonist */
+
+/* threads stream through private buffers bound to numa_node, copying */
+/* the first half of a buffer to the second half. buffers are larger */
+/* than the caches, so that every byte crosses the memory controller */
+/* of numa_node. the threads cpus are set with the -numa_cpus cgroup */
+/* knob: on the node of the buffers the local memory controller is */
+/* saturated, on another node the inter socket interconnect is. */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "numa.h"
+#include "load.h"
+
+
+typedef struct numa_thread
+{
+  const cmdline_t* cmd;
+  volatile uint64_t nbytes;
+} numa_thread_t;
+
+static void* thread_main(void* args)
+{
+  numa_thread_t* const t = (numa_thread_t*)args;
+  const size_t size = t->cmd->numa_size;
+  const size_t half = size / 2;
+  uint8_t* p;
+
+  p = mmap
+    (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+  {
+    PERROR();
+    return NULL;
+  }
+
+  /* -1 is the default policy, the node of the first touch */
+
+  if ((t->cmd->numa_node >= 0) && numa_bind_range(p, size, t->cmd->numa_node))
+  {
+    PERROR();
+    goto on_error;
+  }
+
+  memset(p, 0x2a, size);
+
+  /* a copy reads and writes half bytes each */
+
+  while (is_sigint == 0)
+  {
+    memcpy(p + half, p, half);
+    t->nbytes += 2 * half;
+  }
+
+ on_error:
+  munmap(p, size);
+  return NULL;
+}
+
+
+/* report */
+
+static uint64_t get_count(const void* args)
+{
+  return ((const numa_thread_t*)args)->nbytes;
+}
+
+static void print_rate(void* args, double rate, double dt)
+{
+  const cmdline_t* const cmd = (const cmdline_t*)args;
+  printf("# numa: node=%d GB/s=%.2f\n", cmd->numa_node, rate / 1000000000.0);
+}
+
+
+/* entry point */
+
+void* numa_main(void* args)
+{
+  const cmdline_t* const cmd = (const cmdline_t*)args;
+  numa_thread_t* threads;
+  load_threads_t th;
+  size_t n;
+  size_t i;
+
+  if ((cmd->numa_threads == 0) || (cmd->numa_size < 2))
+  {
+    PERROR();
+    goto on_error_0;
+  }
+
+  n = cmd->numa_threads;
+  threads = calloc(n, sizeof(numa_thread_t));
+  if (threads == NULL) goto on_error_0;
+
+  for (i = 0; i != n; ++i)
+  {
+    threads[i].cmd = cmd;
+    threads[i].nbytes = 0;
+  }
+
+  if (load_threads_start(&th, threads, sizeof(numa_thread_t), n, thread_main))
+    goto on_error_1;
+
+  /* report the memory bandwidth */
+
+  load_threads_report(&th, get_count, print_rate, (void*)cmd);
+  load_threads_join(&th);
+
+ on_error_1:
+  free(threads);
+ on_error_0:
+  return NULL;
+}
@@ -0,0 +1,118 @@
+/* false sharing cache line ping pong antagonist */
+
+/* one thread per share_cpus entry, pinned, increments its own counter. */
+/* counters are packed in one cache line, or padded to one line each */
+/* when share_pad is set, as a control. with packed counters, each */
+/* increment needs the line in exclusive state and steals it from the */
+/* core that last wrote it, so the increments per second of the packed */
+/* run bound the line transfers per second. */
+
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include "load.h"
+
+
+#define CACHE_LINE_SIZE 64
+/* packed counters must fit in one line */
+#define SHARE_MAX_THREADS (CACHE_LINE_SIZE / sizeof(uint64_t))
+
+typedef struct share_thread
+{
+  int cpu;
+  volatile uint64_t* counter;
+} share_thread_t;
+
+static void* thread_main(void* args)
+{
+  share_thread_t* const t = (share_thread_t*)args;
+  volatile uint64_t* const counter = t->counter;
+  cpu_set_t set;
+
+  CPU_ZERO(&set);
+  CPU_SET(t->cpu, &set);
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+  {
+    PERROR();
+    return NULL;
+  }
+
+  while (is_sigint == 0) ++*counter;
+
+  return NULL;
+}
+
+
+/* report */
+
+static uint64_t get_count(const void* args)
+{
+  return *((const share_thread_t*)args)->counter;
+}
+
+static void print_rate(void* args, double rate, double dt)
+{
+  const cmdline_t* const cmd = (const cmdline_t*)args;
+  printf("# share: %s increments/s=%.0f\n",
+	 cmd->share_pad ? "padded" : "packed", rate);
+}
+
+
+/* entry point */
+
+void* share_main(void* args)
+{
+  const cmdline_t* const cmd = (const cmdline_t*)args;
+  share_thread_t threads[SHARE_MAX_THREADS];
+  const size_t stride = cmd->share_pad ? CACHE_LINE_SIZE : sizeof(uint64_t);
+  uint8_t* counters;
+  load_threads_t th;
+  const char* s;
+  char* end;
+  size_t n;
+  size_t i;
+
+  /* parse the cpu list */
+
+  n = 0;
+  for (s = cmd->share_cpus; *s && (n != SHARE_MAX_THREADS); ++n)
+  {
+    threads[n].cpu = (int)strtol(s, &end, 10);
+    if (end == s) break ;
+    s = (*end == ',') ? end + 1 : end;
+  }
+
+  if ((n < 2) || (*s != 0))
+  {
+    PERROR();
+    goto on_error_0;
+  }
+
+  /* counters start on a line boundary */
+
+  if (posix_memalign((void**)&counters, CACHE_LINE_SIZE, n * CACHE_LINE_SIZE))
+    goto on_error_0;
+  memset(counters, 0, n * CACHE_LINE_SIZE);
+
+  for (i = 0; i != n; ++i)
+    threads[i].counter = (volatile uint64_t*)(counters + i * stride);
+
+  if (load_threads_start(&th, threads, sizeof(share_thread_t), n, thread_main))
+    goto on_error_1;
+
+  /* report the increments per second */
+
+  load_threads_report(&th, get_count, print_rate, (void*)cmd);
+  load_threads_join(&th);
+
+ on_error_1:
+  free(counters);
+ on_error_0:
+  return NULL;
+}
@@ -0,0 +1,223 @@
+/* high resolution timer storm antagonist */
+
+/* threads arm periodic high resolution timers at a controlled aggregate */
+/* rate, so that the hrtimer interrupt and the timer softirq of the cores */
+/* they run on compete with the timer and irq paths stat measures. the */
+/* cores are chosen with the -timer_cpus cgroup knob. timer slack is set */
+/* to 1 ns so that expirations are not coalesced. types, one per thread */
+/* in turn: */
+/* timerfd: periodic timerfd, read */
+/* nanosleep: clock_nanosleep at absolute deadlines */
+/* posix: periodic posix timer signaling its thread, sigwaitinfo */
+
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include "load.h"
+
+
+/* older glibc do not name the thread id of sigevent */
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+#define TIMER_SIGNAL SIGRTMIN
+
+typedef struct timer_thread
+{
+  unsigned int type;
+  /* timer period, in ns */
+  uint64_t period;
+  volatile uint64_t nexps;
+} timer_thread_t;
+
+static const char* const type_names[] = { "timerfd", "nanosleep", "posix" };
+#define TYPE_COUNT (sizeof(type_names) / sizeof(type_names[0]))
+
+
+static void set_ns(struct timespec* ts, uint64_t ns)
+{
+  ts->tv_sec = (time_t)(ns / 1000000000);
+  ts->tv_nsec = (long)(ns % 1000000000);
+}
+
+static void timerfd_loop(timer_thread_t* t)
+{
+  struct itimerspec its;
+  uint64_t n;
+  int fd;
+
+  fd = timerfd_create(CLOCK_MONOTONIC, 0);
+  if (fd == -1)
+  {
+    PERROR();
+    return ;
+  }
+
+  set_ns(&its.it_interval, t->period);
+  set_ns(&its.it_value, t->period);
+  if (timerfd_settime(fd, 0, &its, NULL))
+  {
+    PERROR();
+    goto on_error;
+  }
+
+  while (is_sigint == 0)
+  {
+    if (read(fd, &n, sizeof(n)) != (ssize_t)sizeof(n)) continue ;
+    t->nexps += n;
+  }
+
+ on_error:
+  close(fd);
+}
+
+static void nanosleep_loop(timer_thread_t* t)
+{
+  struct timespec deadline;
+
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+  while (is_sigint == 0)
+  {
+    load_add_ns(&deadline, t->period);
+    if (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL))
+      continue ;
+    ++t->nexps;
+  }
+}
+
+static void posix_loop(timer_thread_t* t)
+{
+  /* TIMER_SIGNAL is blocked in every thread, and waited for */
+
+  struct sigevent sev;
+  struct itimerspec its;
+  siginfo_t si;
+  sigset_t set;
+  timer_t timer;
+
+  sigemptyset(&set);
+  sigaddset(&set, TIMER_SIGNAL);
+
+  memset(&sev, 0, sizeof(sev));
+  sev.sigev_notify = SIGEV_THREAD_ID;
+  sev.sigev_signo = TIMER_SIGNAL;
+  sev.sigev_notify_thread_id = (pid_t)syscall(SYS_gettid);
+  if (timer_create(CLOCK_MONOTONIC, &sev, &timer))
+  {
+    PERROR();
+    return ;
+  }
+
+  set_ns(&its.it_interval, t->period);
+  set_ns(&its.it_value, t->period);
+  if (timer_settime(timer, 0, &its, NULL))
+  {
+    PERROR();
+    goto on_error;
+  }
+
+  while (is_sigint == 0)
+  {
+    if (sigwaitinfo(&set, &si) != TIMER_SIGNAL) continue ;
+    /* expirations of a pending signal are merged in the overrun */
+    t->nexps += 1 + (uint64_t)si.si_overrun;
+  }
+
+ on_error:
+  timer_delete(timer);
+}
+
+static void* thread_main(void* args)
+{
+  timer_thread_t* const t = (timer_thread_t*)args;
+
+  prctl(PR_SET_TIMERSLACK, 1UL, 0UL, 0UL, 0UL);
+
+  switch (t->type)
+  {
+  case 0: timerfd_loop(t); break ;
+  case 1: nanosleep_loop(t); break ;
+  default: posix_loop(t); break ;
+  }
+
+  return NULL;
+}
+
+
+/* report */
+
+static uint64_t get_count(const void* args)
+{
+  return ((const timer_thread_t*)args)->nexps;
+}
+
+static void print_rate(void* args, double rate, double dt)
+{
+  const cmdline_t* const cmd = (const cmdline_t*)args;
+  printf("# timer: %s expirations/s=%.0f\n", cmd->timer_type, rate);
+}
+
+
+/* entry point */
+
+void* timer_main(void* args)
+{
+  const cmdline_t* const cmd = (const cmdline_t*)args;
+  unsigned int types[TYPE_COUNT];
+  timer_thread_t* threads;
+  load_threads_t th;
+  sigset_t set;
+  size_t n;
+  size_t i;
+  int ntypes;
+
+  ntypes = load_get_modes(cmd->timer_type, type_names, TYPE_COUNT, types);
+  if ((ntypes <= 0) || (cmd->timer_threads == 0) || (cmd->timer_rate == 0))
+  {
+    PERROR();
+    goto on_error_0;
+  }
+
+  /* inherited by the threads */
+
+  sigemptyset(&set);
+  sigaddset(&set, TIMER_SIGNAL);
+  pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+  n = cmd->timer_threads;
+  threads = calloc(n, sizeof(timer_thread_t));
+  if (threads == NULL) goto on_error_0;
+
+  for (i = 0; i != n; ++i)
+  {
+    threads[i].type = types[i % (size_t)ntypes];
+    threads[i].period = (uint64_t)n * 1000000000 / cmd->timer_rate;
+    if (threads[i].period == 0) threads[i].period = 1;
+    threads[i].nexps = 0;
+  }
+
+  if (load_threads_start(&th, threads, sizeof(timer_thread_t), n, thread_main))
+    goto on_error_1;
+
+  /* report the achieved expiration rate */
+
+  load_threads_report(&th, get_count, print_rate, (void*)cmd);
+  load_threads_join(&th);
+
+ on_error_1:
+  free(threads);
+ on_error_0:
+  return NULL;
+}
@@ -0,0 +1,224 @@
+/* memory pressure antagonist */
+
+/* dirties up to vm_target bytes over and over. run in a group whose */
+/* memory.high is below the target, half of it by default, this keeps */
+/* the group in direct reclaim and kswapd busy. the buffer asks for */
+/* transparent huge pages, whose allocation needs compaction once */
+/* memory is fragmented. swap can be put on zram so that reclaim also */
+/* compresses pages. the reclaim rates are reported every second from */
+/* /proc/vmstat. */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/swap.h>
+#include "load.h"
+
+
+/* zram swap */
+
+#define ZRAM_DEV "/dev/zram0"
+#define ZRAM_SYS "/sys/block/zram0"
+
+static int write_file(const char* path, const char* value)
+{
+  const size_t len = strlen(value);
+  int fd;
+  int err = -1;
+
+  fd = open(path, O_WRONLY);
+  if (fd == -1) return -1;
+  if (write(fd, value, len) == (ssize_t)len) err = 0;
+  close(fd);
+
+  return err;
+}
+
+static int write_swap_header(size_t size)
+{
+  /* mkswap equivalent: version 1 header in the first page, */
+  /* SWAPSPACE2 signature at the end of this page */
+
+  const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  uint8_t* page;
+  uint32_t* h;
+  int fd;
+  int err = -1;
+
+  page = calloc(1, page_size);
+  if (page == NULL) goto on_error_0;
+
+  /* version, last_page, nr_badpages */
+  h = (uint32_t*)(page + 1024);
+  h[0] = 1;
+  h[1] = (uint32_t)(size / page_size - 1);
+  h[2] = 0;
+  memcpy(page + page_size - 10, "SWAPSPACE2", 10);
+
+  fd = open(ZRAM_DEV, O_WRONLY);
+  if (fd == -1) goto on_error_1;
+  if (pwrite(fd, page, page_size, 0) == (ssize_t)page_size) err = 0;
+  close(fd);
+
+ on_error_1:
+  free(page);
+ on_error_0:
+  return err;
+}
+
+static int zram_on(size_t size)
+{
+  /* the zram module must be loaded */
+
+  char buf[32];
+
+  write_file(ZRAM_SYS "/reset", "1");
+  snprintf(buf, sizeof(buf), "%zu", size);
+  if (write_file(ZRAM_SYS "/disksize", buf)) return -1;
+  if (write_swap_header(size)) return -1;
+  if (swapon(ZRAM_DEV, SWAP_FLAG_PREFER | 32767)) return -1;
+  return 0;
+}
+
+static void zram_off(void)
+{
+  swapoff(ZRAM_DEV);
+  write_file(ZRAM_SYS "/reset", "1");
+}
+
+
+/* reclaim statistics */
+
+static const char* const vmstat_names[] =
+{
+  "pgscan_kswapd",
+  "pgscan_direct",
+  "pgsteal_kswapd",
+  "pgsteal_direct",
+  "allocstall",
+  "compact_stall",
+  "compact_success",
+  "pswpin",
+  "pswpout"
+};
+
+#define VMSTAT_COUNT (sizeof(vmstat_names) / sizeof(vmstat_names[0]))
+
+static void read_vmstat(uint64_t* x)
+{
+  /* exact match, except allocstall which sums allocstall_<zone>. */
+  /* a prefix match would also fold ie. pgscan_direct_throttle into */
+  /* pgscan_direct */
+
+  char name[64];
+  size_t len;
+  unsigned long long n;
+  FILE* file;
+  size_t i;
+
+  for (i = 0; i != VMSTAT_COUNT; ++i) x[i] = 0;
+
+  file = fopen("/proc/vmstat", "r");
+  if (file == NULL) return ;
+
+  while (fscanf(file, "%63s %llu", name, &n) == 2)
+  {
+    for (i = 0; i != VMSTAT_COUNT; ++i)
+    {
+      len = strlen(vmstat_names[i]);
+      if (strncmp(name, vmstat_names[i], len)) continue ;
+      if ((name[len] != 0) &&
+	  (strcmp(vmstat_names[i], "allocstall") || (name[len] != '_')))
+	continue ;
+      x[i] += (uint64_t)n;
+      break ;
+    }
+  }
+
+  fclose(file);
+}
+
+static void report(const uint64_t* a, const uint64_t* b, double dt)
+{
+  size_t i;
+
+  printf("# vm:");
+  for (i = 0; i != VMSTAT_COUNT; ++i)
+    printf(" %s/s=%.0f", vmstat_names[i], (double)(b[i] - a[i]) / dt);
+  printf("\n");
+  fflush(stdout);
+}
+
+
+/* entry point */
+
+void* vm_main(void* args)
+{
+  const cmdline_t* const cmd = (const cmdline_t*)args;
+  const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  const size_t n = cmd->vm_target;
+  uint64_t stats[2][VMSTAT_COUNT];
+  unsigned int k = 0;
+  uint8_t pattern = 0;
+  uint8_t* p;
+  double t;
+  double tt;
+  size_t i;
+
+  if (cmd->vm_zram)
+  {
+    if (zram_on(cmd->vm_zram))
+    {
+      PERROR();
+      goto on_error_0;
+    }
+  }
+
+  p = mmap(NULL, n, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (p == MAP_FAILED)
+  {
+    PERROR();
+    goto on_error_1;
+  }
+
+  madvise(p, n, MADV_HUGEPAGE);
+
+  read_vmstat(stats[k]);
+  t = load_time();
+
+  while (is_sigint == 0)
+  {
+    /* dirty every page with a new value, so that reclaimed pages must */
+    /* be written to swap and faulted back */
+
+    ++pattern;
+
+    for (i = 0; (i < n) && (is_sigint == 0); i += page_size)
+    {
+      p[i] = pattern;
+
+      if ((i & ((page_size << 12) - 1)) != 0) continue ;
+
+      tt = load_time();
+      if ((tt - t) < 1.0) continue ;
+
+      if (cmd->vm_compact) write_file("/proc/sys/vm/compact_memory", "1");
+
+      read_vmstat(stats[k ^ 1]);
+      report(stats[k], stats[k ^ 1], tt - t);
+      k ^= 1;
+      t = tt;
+    }
+  }
+
+  munmap(p, n);
+ on_error_1:
+  if (cmd->vm_zram) zram_off();
+ on_error_0:
+  return NULL;
+}
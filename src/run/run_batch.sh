@@ -0,0 +1,37 @@
+#!/usr/bin/env sh
+
+TOP_DIR=`dirname $0`/..
+. $TOP_DIR/run/run_common.sh
+
+# BATCH_FREQS: IRQ frequencies stepped through, in Hz, default
+# 1000 10000 50000 100000. each one is run with per IRQ service, then
+# with batch service
+freqs=${BATCH_FREQS:-1000 10000 50000 100000}
+sfile=$ofile.step
+
+run_bench
+
+echo '# profile: batch' >> $ofile
+echo '# freq batch miss_ratio irqs_per_wake wakes_per_s lat_min lat_p50 lat_p90 lat_p99 lat_p99.9 lat_p99.99 lat_max' >> $ofile
+
+for freq in $freqs; do
+  for batch in 0 1; do
+    $main $args -freq $freq -batch $batch > $sfile
+
+    # one row per run, from the stat report
+    awk -v freq=$freq -v batch=$batch '
+      /^# irq_count/ { n = $NF }
+      /^# irq_missed/ { m = $NF }
+      /^# batch:/ { for (i = 3; i <= NF; ++i) { split($i, o, "="); b[o[1]] = o[2] } }
+      /^# lat_(min|p|max)/ { sub(":", "", $2); x[$2] = $NF }
+      END {
+        printf("%u %u %.6f %s %s", freq, batch, n ? m / n : 0, b["irqs_per_wake"], b["wakes_per_s"])
+        split("min p50 p90 p99 p99.9 p99.99 max", k, " ")
+        for (i = 1; i <= 7; ++i) printf(" %s", x["lat_" k[i]])
+        printf("\n")
+      }' $sfile >> $ofile
+  done
+done
+
+rm -f $sfile
+mv $ofile $TOP_DIR/dat/batch.dat
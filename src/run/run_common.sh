@@ -6,3 +6,10 @@ ofile=/segfs/tmp/rtbench.dat
 
 echo '# machine: ' `uname -a` > $ofile
 echo '# cmdline: ' $args >> $ofile
+
+# measurement overhead of stat itself, run by the stat profiles with
+# their device and wait options, ie. run_bench -dev uio:dummy -wait epoll
+run_bench() {
+  echo '# profile: bench' $@ >> $ofile
+  $main $args "$@" -bench 1 >> $ofile
+}
@@ -3,13 +3,25 @@
 TOP_DIR=`dirname $0`/..
 . $TOP_DIR/run/run_common.sh
 
+run_bench
+
 echo '# profile: load' >> $ofile
+echo '# load: ' $LOAD_ARGS >> $ofile
 
-$TOP_DIR/load/main &
+# LOAD_ARGS: load tool options, ie. cgroup v2 limits per antagonist class.
+# LOAD_ARGS is word split: multi field values are written with ','
+# instead of spaces, ie. -cpu_cpumax 50000,100000 or
+# -fs_iomax 8:0,wbps=10485760
+# the load output, ie. the -chaos steps, is appended after the stat
+# report
+$TOP_DIR/load/main $LOAD_ARGS > $ofile.load &
 LOAD_PID=$!
 
 $main $args >> $ofile
 
 kill -2 $LOAD_PID
+wait $LOAD_PID
+cat $ofile.load >> $ofile
+rm -f $ofile.load
 
 mv $ofile $TOP_DIR/dat/load.dat
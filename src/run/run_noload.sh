@@ -3,6 +3,8 @@
 TOP_DIR=`dirname $0`/..
 . $TOP_DIR/run/run_common.sh
 
+run_bench
+
 echo '# profile: noload' >> $ofile
 $main $args >> $ofile
 
@@ -0,0 +1,88 @@
+#!/usr/bin/env sh
+
+TOP_DIR=`dirname $0`/..
+. $TOP_DIR/run/run_common.sh
+
+# PLACE_IRQ: the device IRQ number, required
+# PLACE_CPUS: cpus stepped through, ie. 0-3,8. default all online
+# PLACE_LOAD: antagonist classes on the remaining cpus, default cpu,mem.
+# empty runs without antagonists.
+# LOAD_ARGS: other load tool options.
+# LOAD_ARGS is word split: multi field values are written with ','
+# instead of spaces, ie. -cpu_cpumax 50000,100000 or
+# -fs_iomax 8:0,wbps=10485760
+if [ -z "$PLACE_IRQ" ]; then
+  echo 'PLACE_IRQ is required'
+  exit 1
+fi
+
+expand() {
+  echo $1 | awk -F, '{
+    for (i = 1; i <= NF; ++i) {
+      n = split($i, r, "-"); if (n == 1) r[2] = r[1]
+      for (j = r[1]; j <= r[2]; ++j) printf("%d\n", j)
+    }
+  }'
+}
+
+online=`expand $(cat /sys/devices/system/cpu/online)`
+cpus=`expand ${PLACE_CPUS:-$(cat /sys/devices/system/cpu/online)}`
+load=${PLACE_LOAD-cpu,mem}
+sfile=$ofile.step
+
+run_bench
+
+echo '# profile: placement' >> $ofile
+echo '# load: ' $load $LOAD_ARGS >> $ofile
+echo '# rt_cpu irq_cpu miss_ratio lat_min lat_p50 lat_p90 lat_p99 lat_p99.9 lat_p99.99 lat_max' >> $ofile
+
+for rt in $cpus; do
+  for irq in $cpus; do
+    # antagonists are confined to the cpus left
+    rest=`echo $online | tr ' ' '\n' | grep -v -x -e $rt -e $irq | paste -s -d, -`
+
+    LOAD_PID=
+    if [ -n "$load" ] && [ -n "$rest" ]; then
+      knobs=
+      for c in `echo $load | tr ',' ' '`; do knobs="$knobs -${c}_cpus $rest"; done
+      # the load output of every placement is appended at the end
+      echo '# load: rt_cpu='$rt 'irq_cpu='$irq >> $ofile.load
+      $TOP_DIR/load/main $LOAD_ARGS -run $load $knobs >> $ofile.load &
+      LOAD_PID=$!
+    fi
+
+    $main $args -cpu $rt -irq $PLACE_IRQ -irq_cpu $irq > $sfile
+
+    if [ -n "$LOAD_PID" ]; then
+      kill -2 $LOAD_PID
+      wait $LOAD_PID
+    fi
+
+    # one matrix row per placement, from the stat report
+    awk -v rt=$rt -v irq=$irq '
+      /^# irq_count/ { n = $NF }
+      /^# irq_missed/ { m = $NF }
+      /^# lat_(min|p|max)/ { sub(":", "", $2); x[$2] = $NF }
+      END {
+        printf("%u %u %.6f", rt, irq, n ? m / n : 0)
+        split("min p50 p90 p99 p99.9 p99.99 max", k, " ")
+        for (i = 1; i <= 7; ++i) printf(" %s", x["lat_" k[i]])
+        printf("\n")
+      }' $sfile >> $ofile
+  done
+done
+
+# best placement on the p99.9, misses first
+awk '
+  /^[0-9]/ {
+    if (!n++ || $3 < m || ($3 == m && $8 < p)) { m = $3; p = $8; r = $1; i = $2 }
+  }
+  END { if (n) printf("# best: rt_cpu=%s irq_cpu=%s miss_ratio=%s lat_p99.9=%s\n", r, i, m, p) }
+' $ofile > $sfile
+cat $sfile >> $ofile
+
+# no load output without antagonists
+if [ -f $ofile.load ]; then cat $ofile.load >> $ofile; fi
+
+rm -f $sfile $ofile.load
+mv $ofile $TOP_DIR/dat/placement.dat
@@ -0,0 +1,81 @@
+#!/usr/bin/env sh
+
+TOP_DIR=`dirname $0`/..
+. $TOP_DIR/run/run_common.sh
+
+# SWEEP_CLASS: swept antagonist class, default cpu
+# SWEEP_STEP: duty cycle increment, in percent, default 10
+# SWEEP_PCT: percentile of the knee and slo, default p99
+# SWEEP_SLO: latency slo in us, reports the highest duty meeting it
+# LOAD_ARGS: other load tool options, ie. the class options.
+# LOAD_ARGS is word split: multi field values are written with ','
+# instead of spaces, ie. -cpu_cpumax 50000,100000 or
+# -fs_iomax 8:0,wbps=10485760
+class=${SWEEP_CLASS:-cpu}
+step=${SWEEP_STEP:-10}
+pct=${SWEEP_PCT:-p99}
+sfile=$ofile.step
+
+run_bench
+
+echo '# profile: sweep' >> $ofile
+echo '# load: ' $LOAD_ARGS >> $ofile
+echo '# sweep: class='$class 'step='$step 'pct='$pct 'slo='$SWEEP_SLO >> $ofile
+echo '# duty miss_ratio lat_min lat_p50 lat_p90 lat_p99 lat_p99.9 lat_p99.99 lat_max' >> $ofile
+
+duty=0
+while [ $duty -le 100 ]; do
+  # the load output of every step is appended at the end
+  echo '# load: duty='$duty >> $ofile.load
+  $TOP_DIR/load/main $LOAD_ARGS -run $class -${class}_duty $duty >> $ofile.load &
+  LOAD_PID=$!
+
+  $main $args > $sfile
+
+  kill -2 $LOAD_PID
+  wait $LOAD_PID
+
+  # one curve point per step, from the stat report
+  awk -v duty=$duty '
+    /^# irq_count/ { n = $NF }
+    /^# irq_missed/ { m = $NF }
+    /^# lat_(min|p|max)/ { sub(":", "", $2); x[$2] = $NF }
+    END {
+      printf("%u %.6f", duty, n ? m / n : 0)
+      split("min p50 p90 p99 p99.9 p99.99 max", k, " ")
+      for (i = 1; i <= 7; ++i) printf(" %s", x["lat_" k[i]])
+      printf("\n")
+    }' $sfile >> $ofile
+
+  duty=$((duty + step))
+done
+
+# knee: the point farthest from the chord between the first and the
+# last points of the percentile curve, both axes normalized
+awk -v pct=$pct -v slo=$SWEEP_SLO '
+  /^# duty / { for (i = 2; i <= NF; ++i) if ($i == "lat_" pct) c = i - 1 }
+  /^[0-9]/ { ++n; x[n] = $1; y[n] = $c }
+  END {
+    if (n < 3 || c == 0) exit
+    dx = x[n] - x[1]; dy = y[n] - y[1]
+    best = 0; dmax = 0
+    for (i = 1; i <= n; ++i) {
+      if (dy <= 0) break
+      d = (x[i] - x[1]) / dx - (y[i] - y[1]) / dy
+      if (d < 0) d = -d
+      if (d > dmax) { dmax = d; best = i }
+    }
+    # a flat or decreasing curve has no knee
+    if (best) printf("# knee: duty=%s lat_%s=%s\n", x[best], pct, y[best])
+    else printf("# knee: none\n")
+    if (slo != "") {
+      ok = "none"
+      for (i = 1; i <= n; ++i) if (y[i] <= slo) ok = x[i]; else break
+      printf("# slo: duty=%s lat_%s<=%s\n", ok, pct, slo)
+    }
+  }' $ofile >> $ofile.knee
+cat $ofile.knee >> $ofile
+cat $ofile.load >> $ofile
+
+rm -f $sfile $ofile.knee $ofile.load
+mv $ofile $TOP_DIR/dat/sweep.dat
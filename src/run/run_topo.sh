@@ -0,0 +1,12 @@
+#!/usr/bin/env sh
+
+TOP_DIR=`dirname $0`/..
+. $TOP_DIR/run/run_common.sh
+
+echo '# profile: topo' >> $ofile
+echo '# topo: ' $TOPO_ARGS >> $ofile
+
+# TOPO_ARGS: topo tool options, ie. -isolated 1 to measure isolated cpus
+$TOP_DIR/topo/main $TOPO_ARGS >> $ofile
+
+mv $ofile $TOP_DIR/dat/topo.dat
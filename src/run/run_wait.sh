@@ -0,0 +1,56 @@
+#!/usr/bin/env sh
+
+TOP_DIR=`dirname $0`/..
+. $TOP_DIR/run/run_common.sh
+
+# WAIT_DEV: event source with an IRQ fd, default uio:0. uio:dummy
+# runs without the device
+# WAIT_MODES: compared wait modes, default direct epoll uring
+# uring_sqpoll busy. the first one is the reference of the deltas.
+# cpu_thread and cpu_process are the cpu time of the realtime task and
+# of the process (SQPOLL thread included), per second of run
+# WAIT_CPU: cpu of the SQPOLL kernel thread, default not pinned
+dev=${WAIT_DEV:-uio:0}
+modes=${WAIT_MODES:-direct epoll uring uring_sqpoll busy}
+sfile=$ofile.step
+
+for mode in $modes; do
+  run_bench -dev $dev -wait $mode ${WAIT_CPU:+-wait_cpu $WAIT_CPU}
+done
+
+echo '# profile: wait' >> $ofile
+echo '# wait: dev='$dev >> $ofile
+echo '# mode miss_ratio other_events cpu_thread cpu_process lat_min lat_p50 lat_p90 lat_p99 lat_p99.9 lat_p99.99 lat_max' >> $ofile
+
+for mode in $modes; do
+  $main $args -dev $dev -wait $mode ${WAIT_CPU:+-wait_cpu $WAIT_CPU} > $sfile
+
+  # one row per mode, from the stat report
+  awk -v mode=$mode '
+    /^# irq_count/ { n = $NF }
+    /^# irq_missed/ { m = $NF }
+    /^# wait:/ { split($NF, o, "="); e = o[2] }
+    /^# cpu:/ { for (i = 3; i <= NF; ++i) { split($i, o, "="); c[o[1]] = o[2] } }
+    /^# lat_(min|p|max)/ { sub(":", "", $2); x[$2] = $NF }
+    END {
+      w = c["wall"] ? c["wall"] : 1
+      printf("%s %.6f %u %.3f %.3f", mode, n ? m / n : 0, e, c["thread"] / w, c["process"] / w)
+      split("min p50 p90 p99 p99.9 p99.99 max", k, " ")
+      for (i = 1; i <= 7; ++i) printf(" %s", x["lat_" k[i]])
+      printf("\n")
+    }' $sfile >> $ofile
+done
+
+# extra cost and latency (in us) of each mode over the first one
+awk '
+  /^# mode / { for (i = 5; i <= NF; ++i) k[i - 1] = $i; nf = NF - 1 }
+  /^[a-z]/ {
+    if (!n++) { for (i = 4; i <= nf; ++i) r[i] = $i; ref = $1; next }
+    printf("# delta: %s-%s", $1, ref)
+    for (i = 4; i <= nf; ++i) printf(" %s=%g", k[i], $i - r[i])
+    printf("\n")
+  }' $ofile > $sfile
+cat $sfile >> $ofile
+
+rm -f $sfile
+mv $ofile $TOP_DIR/dat/wait.dat
@@ -0,0 +1,345 @@
+/* each benchmark sample times a batch of operations, with */
+/* CLOCK_MONOTONIC and, on x86, the time stamp counter. the per */
+/* operation cost is the batch time divided by the batch size, so that */
+/* fast operations are not hidden by the timestamp cost. distributions */
+/* are kept in histograms of batch times, in ns and in cycles. */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hist.h"
+#include "trace.h"
+#include "debug.h"
+#include "dev.h"
+#include "synth.h"
+#include "waiter.h"
+#include "bench.h"
+
+
+/* batch times up to 1 ms, or 1M cycles */
+#define BENCH_MAX_COUNT 1000000
+
+/* wait benchmark IRQ frequency, and the batch of other benchmarks */
+#define BENCH_WAIT_FGEN 10000
+#define BENCH_BATCH 64
+
+#define BENCH_RING_SIZE 1024
+
+/* hist_record latencies, drawn ahead from the synth model */
+#define BENCH_LAT_COUNT (1 << 12)
+
+#if defined(__i386__) || defined(__x86_64__)
+#define BENCH_HAS_TSC 1
+static inline uint64_t get_tsc(void)
+{
+  uint32_t lo;
+  uint32_t hi;
+  __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t)hi << 32) | (uint64_t)lo;
+}
+#else
+#define BENCH_HAS_TSC 0
+static inline uint64_t get_tsc(void)
+{
+  return 0;
+}
+#endif
+
+static inline uint64_t get_ns(clockid_t id)
+{
+  struct timespec ts;
+  clock_gettime(id, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+
+/* benchmark context and operations */
+
+typedef struct bench_ctx
+{
+  dev_handle_t dev;
+  uint32_t fclk;
+  hist_t hist;
+  trace_writer_t trace;
+  uint32_t lat[BENCH_LAT_COUNT];
+  size_t lat_pos;
+  volatile uint64_t sink;
+} bench_ctx_t;
+
+static void op_rd32(bench_ctx_t* ctx, size_t n)
+{
+  uint32_t x;
+  size_t i;
+  for (i = 0; i != n; ++i)
+  {
+    dev_rd32(&ctx->dev, REG_NOW, &x);
+    ctx->sink += x;
+  }
+}
+
+static void op_hist(bench_ctx_t* ctx, size_t n)
+{
+  size_t i;
+  for (i = 0; i != n; ++i)
+  {
+    hist_record(&ctx->hist, ctx->lat[ctx->lat_pos]);
+    ctx->lat_pos = (ctx->lat_pos + 1) & (BENCH_LAT_COUNT - 1);
+  }
+}
+
+static void op_trace(bench_ctx_t* ctx, size_t n)
+{
+  trace_rec_t rec;
+  size_t i;
+
+  rec.start = 0;
+  rec.count = 0;
+  rec.mask = 1;
+  for (i = 0; i != n; ++i)
+  {
+    rec.now = (uint32_t)i;
+    trace_writer_push(&ctx->trace, &rec);
+  }
+
+  /* drained by hand, there is no writer thread */
+  ctx->trace.tail = ctx->trace.head;
+}
+
+static void op_clock(bench_ctx_t* ctx, size_t n, clockid_t id)
+{
+  size_t i;
+  for (i = 0; i != n; ++i) ctx->sink += get_ns(id);
+}
+
+static void op_monotonic(bench_ctx_t* ctx, size_t n)
+{
+  op_clock(ctx, n, CLOCK_MONOTONIC);
+}
+
+static void op_monotonic_raw(bench_ctx_t* ctx, size_t n)
+{
+  op_clock(ctx, n, CLOCK_MONOTONIC_RAW);
+}
+
+static void op_monotonic_coarse(bench_ctx_t* ctx, size_t n)
+{
+  op_clock(ctx, n, CLOCK_MONOTONIC_COARSE);
+}
+
+static void op_realtime(bench_ctx_t* ctx, size_t n)
+{
+  op_clock(ctx, n, CLOCK_REALTIME);
+}
+
+static void op_tsc(bench_ctx_t* ctx, size_t n)
+{
+  size_t i;
+  for (i = 0; i != n; ++i) ctx->sink += get_tsc();
+}
+
+typedef struct bench_op
+{
+  const char* name;
+  void (*fn)(bench_ctx_t*, size_t);
+  unsigned int is_tsc;
+} bench_op_t;
+
+static const bench_op_t ops[] =
+{
+  { "rd32", op_rd32, 0 },
+  { "hist_record", op_hist, 0 },
+  { "trace_push", op_trace, 0 },
+  { "clock_monotonic", op_monotonic, 0 },
+  { "clock_monotonic_raw", op_monotonic_raw, 0 },
+  { "clock_monotonic_coarse", op_monotonic_coarse, 0 },
+  { "clock_realtime", op_realtime, 0 },
+  { "rdtsc", op_tsc, 1 }
+};
+
+#define OP_COUNT (sizeof(ops) / sizeof(ops[0]))
+
+
+/* report */
+
+static void print_dist
+(const char* name, const char* unit, const hist_t* h, size_t batch)
+{
+  static const double p[] = { 0, 50, 90, 99, 99.9, 100 };
+  static const char* const s[] = { "min", "p50", "p90", "p99", "p99.9", "max" };
+  uint32_t x[sizeof(p) / sizeof(p[0])];
+  size_t i;
+
+  if (hist_percentiles(h, p, x, sizeof(p) / sizeof(p[0]))) return ;
+
+  printf("# bench: %s unit=%s n=%llu",
+	 name, unit, (unsigned long long)hist_total(h));
+  for (i = 0; i != sizeof(p) / sizeof(p[0]); ++i)
+    printf(" %s=%.2f", s[i], (double)x[i] / (double)batch);
+  printf("\n");
+}
+
+static void run_op
+(bench_ctx_t* ctx, const bench_op_t* op, size_t count,
+ hist_t* ns, hist_t* cycles)
+{
+  uint64_t t[2];
+  uint64_t c[2];
+  size_t i;
+
+  hist_clear(ns);
+  hist_clear(cycles);
+
+  /* warm up the caches and the branch predictors */
+  op->fn(ctx, BENCH_BATCH);
+
+  for (i = 0; i != count; ++i)
+  {
+    c[0] = get_tsc();
+    t[0] = get_ns(CLOCK_MONOTONIC);
+    op->fn(ctx, BENCH_BATCH);
+    t[1] = get_ns(CLOCK_MONOTONIC);
+    c[1] = get_tsc();
+    hist_record(ns, (uint32_t)(t[1] - t[0]));
+    hist_record(cycles, (uint32_t)(c[1] - c[0]));
+  }
+
+  print_dist(op->name, "ns", ns, BENCH_BATCH);
+  if (BENCH_HAS_TSC) print_dist(op->name, "cycles", cycles, BENCH_BATCH);
+}
+
+static int run_wait
+(bench_ctx_t* ctx, const bench_arg_t* arg, hist_t* ns, hist_t* cycles)
+{
+  /* IRQs every 1 / BENCH_WAIT_FGEN s. after each wait, spinning for 2 */
+  /* periods makes the next IRQ pending, so only the system call round */
+  /* trip and the handler bookkeeping are timed, in the -wait mode */
+
+  const uint64_t period = 1000000000ULL / BENCH_WAIT_FGEN;
+  const uint32_t fdiv = ctx->fclk / BENCH_WAIT_FGEN;
+  waiter_t waiter;
+  uint64_t t[2];
+  uint64_t c[2];
+  uint64_t deadline;
+  uint32_t mask;
+  size_t i;
+  int err;
+
+  if (fdiv == 0) return -1;
+
+  if (waiter_open
+      (&waiter, &ctx->dev, arg->wait_mode, arg->wait_cpu, arg->feeder))
+  {
+    PERROR();
+    return -1;
+  }
+
+  hist_clear(ns);
+  hist_clear(cycles);
+
+  dev_wr32(&ctx->dev, REG_CTL, (1 << 31) | fdiv);
+
+  for (i = 0; i != arg->count; ++i)
+  {
+    deadline = get_ns(CLOCK_MONOTONIC) + 2 * period;
+    while (get_ns(CLOCK_MONOTONIC) < deadline) ;
+
+    c[0] = get_tsc();
+    t[0] = get_ns(CLOCK_MONOTONIC);
+    err = waiter_wait(&waiter, 1000, &mask);
+    t[1] = get_ns(CLOCK_MONOTONIC);
+    c[1] = get_tsc();
+
+    /* end of an offline source */
+    if (err == 1) break ;
+    if ((err == -1) || (mask == 0))
+    {
+      PERROR();
+      break ;
+    }
+
+    hist_record(ns, (uint32_t)(t[1] - t[0]));
+    hist_record(cycles, (uint32_t)(c[1] - c[0]));
+  }
+
+  dev_wr32(&ctx->dev, REG_CTL, 0);
+  waiter_close(&waiter);
+
+  print_dist("wait_pending", "ns", ns, 1);
+  if (BENCH_HAS_TSC) print_dist("wait_pending", "cycles", cycles, 1);
+
+  return 0;
+}
+
+
+/* entry point, run as the realtime task */
+
+int bench_main(void* p)
+{
+  const bench_arg_t* const arg = (const bench_arg_t*)p;
+  bench_ctx_t* ctx;
+  synth_t synth;
+  hist_t ns;
+  hist_t cycles;
+  size_t i;
+  int err = -1;
+
+  ctx = calloc(1, sizeof(bench_ctx_t));
+  if (ctx == NULL) goto on_error_0;
+
+  if (hist_init(&ns, BENCH_MAX_COUNT, 1)) goto on_error_1;
+  if (hist_init(&cycles, BENCH_MAX_COUNT, 1)) goto on_error_2;
+  if (hist_init(&ctx->hist, arg->lat_count, arg->lat_res)) goto on_error_3;
+
+  /* a trace writer without thread nor file */
+
+  ctx->trace.ring = malloc(BENCH_RING_SIZE * sizeof(trace_rec_t));
+  if (ctx->trace.ring == NULL) goto on_error_4;
+  ctx->trace.size = BENCH_RING_SIZE;
+
+  if (dev_open(&ctx->dev, arg->dev_spec))
+  {
+    PERROR();
+    goto on_error_5;
+  }
+
+  dev_wr32(&ctx->dev, REG_CTL, 0);
+  dev_rd32(&ctx->dev, REG_FCLK, &ctx->fclk);
+
+  /* latencies in us, as the stat histogram records them: the synth */
+  /* model with a 1 MHz clock */
+
+  synth_init(&synth, 0x2a);
+  for (i = 0; i != BENCH_LAT_COUNT; ++i)
+    ctx->lat[i] = synth_lat_ticks(&synth, 1000000);
+
+  printf("# bench: batch=%u tsc=%u wait=%s\n", BENCH_BATCH, BENCH_HAS_TSC,
+	 waiter_mode_name(arg->wait_mode));
+
+  for (i = 0; i != OP_COUNT; ++i)
+  {
+    if (ops[i].is_tsc && (BENCH_HAS_TSC == 0)) continue ;
+    run_op(ctx, &ops[i], arg->count, &ns, &cycles);
+  }
+
+  if (run_wait(ctx, arg, &ns, &cycles)) goto on_error_6;
+
+  err = 0;
+
+ on_error_6:
+  dev_close(&ctx->dev);
+ on_error_5:
+  free(ctx->trace.ring);
+ on_error_4:
+  hist_fini(&ctx->hist);
+ on_error_3:
+  hist_fini(&cycles);
+ on_error_2:
+  hist_fini(&ns);
+ on_error_1:
+  free(ctx);
+ on_error_0:
+  return err;
+}
@@ -0,0 +1,36 @@
+#ifndef BENCH_H_INCLUDED
+#define BENCH_H_INCLUDED
+
+
+/* measurement overhead of stat itself: register read, wait with an */
+/* already pending IRQ, histogram and trace updates, timestamp sources. */
+/* run as the realtime task, with the same policy and placement. */
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include "evloop.h"
+
+
+#define BENCH_DEFAULT_COUNT 10000
+
+typedef struct bench_arg
+{
+  /* event source, as -dev */
+  const char* dev_spec;
+  /* IRQ wait of the wait benchmark, as -wait and -wait_cpu */
+  unsigned int wait_mode;
+  int wait_cpu;
+  /* started by the main thread in the epoll mode */
+  const evloop_feeder_t* feeder;
+  /* latency histogram geometry of stat, for hist_record */
+  size_t lat_count;
+  uint32_t lat_res;
+  /* samples per benchmark, BENCH_DEFAULT_COUNT if -count is 0 */
+  size_t count;
+} bench_arg_t;
+
+int bench_main(void*);
+
+
+#endif /* BENCH_H_INCLUDED */
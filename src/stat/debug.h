@@ -0,0 +1,29 @@
+#ifndef DEBUG_H_INCLUDED
+#define DEBUG_H_INCLUDED
+
+
+/* PERROR and ASSUME are realtime safe, they push records to rtlog. */
+/* PRINTF calls printf, it must not be used on the realtime path. */
+
+
+#define CONFIG_DEBUG 1
+#if (CONFIG_DEBUG == 1)
+#include <stdio.h>
+#include "rtlog.h"
+#define ASSUME(__x) \
+do { if (!(__x)) rtlog_push(__FILE__, __LINE__, "assume", 0, 0); } while (0)
+#define PRINTF(__s, ...) \
+do { printf(__s, ## __VA_ARGS__); } while (0)
+#define PERROR() \
+do { rtlog_push(__FILE__, __LINE__, NULL, 0, 0); } while (0)
+#define PERROR_ARGS(__fmt, __a, __b) \
+do { rtlog_push(__FILE__, __LINE__, __fmt, __a, __b); } while (0)
+#else
+#define ASSUME(__x)
+#define PRINTF(__s, ...)
+#define PERROR()
+#define PERROR_ARGS(__fmt, __a, __b)
+#endif
+
+
+#endif /* DEBUG_H_INCLUDED */
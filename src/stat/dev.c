@@ -0,0 +1,60 @@
+#include <string.h>
+#include <poll.h>
+#include "dev.h"
+
+
+static const dev_ops_t* const all_ops[] =
+{
+  &dev_hw_ops,
+  &dev_replay_ops,
+  &dev_synth_ops,
+  &dev_sim_ops,
+  &dev_uio_ops,
+  &dev_vfio_ops
+};
+
+const dev_ops_t* dev_find(const char* spec)
+{
+  /* spec is <name>[:<arg>] */
+
+  const char* const sep = strchr(spec, ':');
+  const size_t len = (sep == NULL) ? strlen(spec) : (size_t)(sep - spec);
+  size_t i;
+
+  for (i = 0; i != sizeof(all_ops) / sizeof(all_ops[0]); ++i)
+  {
+    const char* const name = all_ops[i]->name;
+    if ((strlen(name) == len) && (strncmp(name, spec, len) == 0))
+      return all_ops[i];
+  }
+
+  return NULL;
+}
+
+int dev_open(dev_handle_t* dev, const char* spec)
+{
+  const char* const sep = strchr(spec, ':');
+
+  dev->ops = dev_find(spec);
+  if (dev->ops == NULL) return -1;
+
+  return dev->ops->open(dev, (sep == NULL) ? NULL : sep + 1);
+}
+
+int dev_fd_wait(dev_handle_t* dev, unsigned int ms, uint32_t* mask)
+{
+  struct pollfd pfd;
+  int err;
+
+  if (dev_arm(dev)) return -1;
+
+  pfd.fd = dev_fd(dev);
+  pfd.events = POLLIN;
+  err = poll(&pfd, 1, (int)ms);
+  if (err == -1) return -1;
+
+  *mask = 0;
+  if (err == 0) return 0;
+
+  return dev_ack(dev, mask);
+}
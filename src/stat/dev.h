@@ -0,0 +1,118 @@
+#ifndef DEV_H_INCLUDED
+#define DEV_H_INCLUDED
+
+
+/* event source abstraction. rtask_main only sees the HDL registers */
+/* and an IRQ wait, so that the same latency, miss detection and */
+/* reporting code runs on the hardware or on offline sources: */
+/* hw: the HDL, through libepci and libuirq */
+/* replay:<path>: a trace recorded by stat -trace */
+/* synth:<seed>: a seeded synthetic sample generator */
+/* sim:<seed>[,<fclk>]: the HDL emulated in virtual time */
+/* uio:<n>: the HDL, through /dev/uioN. uio:dummy: a timer stand-in */
+/* vfio:<group>,<bdf>: the HDL, through vfio-pci */
+
+
+#include <stdint.h>
+#include <stddef.h>
+
+
+/* HDL registers, see main.c */
+
+#define REG_CTL 0x00
+#define REG_TOGL 0x08
+#define REG_MAGIC 0x0c
+#define REG_FCLK 0x10
+#define REG_START 0x14
+#define REG_NOW 0x18
+#define REG_COUNT 0x1c
+
+#define REG_MAGIC_VALUE 0xbadcafee
+
+struct dev_handle;
+
+typedef struct dev_ops
+{
+  const char* name;
+
+  /* offline sources run as fast as possible, no realtime policy */
+  unsigned int is_offline;
+
+  int (*open)(struct dev_handle*, const char*);
+  void (*close)(struct dev_handle*);
+
+  /* 0 on IRQ or timeout (mask is 0), 1 at the end of the source, */
+  /* -1 on error */
+  int (*wait)(struct dev_handle*, unsigned int, uint32_t*);
+
+  void (*rd32)(struct dev_handle*, size_t, uint32_t*);
+  void (*wr32)(struct dev_handle*, size_t, uint32_t);
+
+  /* pollable IRQ fd, for event loops. NULL if the source has none. */
+  /* arm is called before waiting on the fd, ack once it is readable: */
+  /* ack consumes the event and sets the mask as wait does */
+  int (*fd)(struct dev_handle*);
+  int (*arm)(struct dev_handle*);
+  int (*ack)(struct dev_handle*, uint32_t*);
+} dev_ops_t;
+
+typedef struct dev_handle
+{
+  const dev_ops_t* ops;
+  void* priv;
+} dev_handle_t;
+
+extern const dev_ops_t dev_hw_ops;
+extern const dev_ops_t dev_replay_ops;
+extern const dev_ops_t dev_synth_ops;
+extern const dev_ops_t dev_sim_ops;
+extern const dev_ops_t dev_uio_ops;
+extern const dev_ops_t dev_vfio_ops;
+
+/* resolve the ops from a spec, without opening the device */
+const dev_ops_t* dev_find(const char*);
+
+int dev_open(dev_handle_t*, const char*);
+
+/* wait implementation of the sources with an IRQ fd: arm, poll, ack */
+int dev_fd_wait(dev_handle_t*, unsigned int, uint32_t*);
+
+static inline void dev_close(dev_handle_t* dev)
+{
+  dev->ops->close(dev);
+}
+
+static inline int dev_wait(dev_handle_t* dev, unsigned int ms, uint32_t* mask)
+{
+  return dev->ops->wait(dev, ms, mask);
+}
+
+static inline int dev_fd(dev_handle_t* dev)
+{
+  /* -1 if the source has no IRQ fd */
+  if (dev->ops->fd == NULL) return -1;
+  return dev->ops->fd(dev);
+}
+
+static inline int dev_arm(dev_handle_t* dev)
+{
+  return dev->ops->arm(dev);
+}
+
+static inline int dev_ack(dev_handle_t* dev, uint32_t* mask)
+{
+  return dev->ops->ack(dev, mask);
+}
+
+static inline void dev_rd32(dev_handle_t* dev, size_t off, uint32_t* x)
+{
+  dev->ops->rd32(dev, off, x);
+}
+
+static inline void dev_wr32(dev_handle_t* dev, size_t off, uint32_t x)
+{
+  dev->ops->wr32(dev, off, x);
+}
+
+
+#endif /* DEV_H_INCLUDED */
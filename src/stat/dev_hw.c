@@ -0,0 +1,153 @@
+/* HDL device, accessed through libepci and waited through libuirq */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "libuirq.h"
+#include "libepci.h"
+#include "debug.h"
+#include "dev.h"
+
+
+#define REG_BAR 0x01
+#define REG_BASE 0x80
+
+typedef struct hw
+{
+  uirq_handle_t uirq;
+  epcihandle_t epci;
+} hw_t;
+
+static int enable_ebone_slave_interrupt(void)
+{
+  /* ebm0 documentation: ebm0_pcie_a.pdf */
+
+  epcihandle_t bar0_handle;
+  uint32_t x;
+
+  bar0_handle = epci_open("10ee:eb01", NULL, 0);
+  if (bar0_handle == EPCI_BAD_HANDLE) return -1;
+
+  /* control register 0 */
+  /* ebone slave interrupt enable (bit 9) */
+  /* global interrupt enable (bit 31) */
+  epci_rd32_reg(bar0_handle, 0x0, &x);
+  x |= (1 << 31) | (1 << 9);
+  epci_wr32_reg(bar0_handle, 0x0, x);
+
+  /* which slave triggers an interrupt can be known */
+  /* using status register 1 (offset 0x14) */
+
+  epci_close(bar0_handle);
+
+  return 0;
+}
+
+/* debugging probe setup */
+
+__attribute__((unused)) static void setup_probe(void)
+{
+  /* const uint32_t value = (10 << 15) | (9 << 10) | (8 << 5) | (12 << 0); */
+  static const uint32_t value = (19 << 15) | (21 << 10) | (20 << 5) | (17 << 0);
+  static char* const device_id = "10ee:eb01";
+  epcihandle_t bar;
+  bar = epci_open(device_id, NULL, 0);
+  epci_wr32_reg(bar, 0x0004, value);
+  epci_close(bar);
+}
+
+static int hw_open(dev_handle_t* dev, const char* arg)
+{
+  hw_t* hw;
+
+  hw = malloc(sizeof(hw_t));
+  if (hw == NULL) goto on_error_0;
+
+  /* initialize uirq */
+
+  if (enable_ebone_slave_interrupt())
+  {
+    PERROR();
+    goto on_error_1;
+  }
+
+  if (uirq_init_lib())
+  {
+    PERROR();
+    goto on_error_1;
+  }
+
+  if (uirq_open(&hw->uirq))
+  {
+    PERROR();
+    goto on_error_2;
+  }
+
+  if (uirq_set_mask(&hw->uirq, 1 << 1, 1))
+  {
+    PERROR();
+    goto on_error_3;
+  }
+
+  hw->epci = epci_open("10ee:eb01", NULL, REG_BAR);
+  if (hw->epci == EPCI_BAD_HANDLE)
+  {
+    PERROR();
+    goto on_error_3;
+  }
+
+  dev->priv = hw;
+
+  return 0;
+
+ on_error_3:
+  uirq_close(&hw->uirq);
+ on_error_2:
+  /* uirq_fini_lib(); */
+ on_error_1:
+  free(hw);
+ on_error_0:
+  return -1;
+}
+
+static void hw_close(dev_handle_t* dev)
+{
+  hw_t* const hw = dev->priv;
+
+  epci_close(hw->epci);
+  uirq_close(&hw->uirq);
+  /* uirq_fini_lib(); */
+  free(hw);
+}
+
+static int hw_wait(dev_handle_t* dev, unsigned int ms, uint32_t* mask)
+{
+  hw_t* const hw = dev->priv;
+  return uirq_wait(&hw->uirq, ms, mask);
+}
+
+static void hw_rd32(dev_handle_t* dev, size_t off, uint32_t* x)
+{
+  hw_t* const hw = dev->priv;
+  epci_rd32_reg(hw->epci, REG_BASE + off, x);
+}
+
+static void hw_wr32(dev_handle_t* dev, size_t off, uint32_t x)
+{
+  hw_t* const hw = dev->priv;
+  epci_wr32_reg(hw->epci, REG_BASE + off, x);
+}
+
+const dev_ops_t dev_hw_ops =
+{
+  "hw",
+  0,
+  hw_open,
+  hw_close,
+  hw_wait,
+  hw_rd32,
+  hw_wr32,
+  NULL,
+  NULL,
+  NULL
+};
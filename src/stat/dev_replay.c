@@ -0,0 +1,201 @@
+/* offline record sources: recorded traces and synthetic samples */
+
+/* both produce trace records, one per wait. registers read between */
+/* two waits return the fields of the current record, so that the */
+/* realtime task computes exactly what it computed during the recording. */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+#include "synth.h"
+#include "debug.h"
+#include "dev.h"
+
+
+/* synthetic samples use a fixed clock */
+#define SYNTH_FCLK 100000000
+/* probability of an IRQ lost by the device */
+#define SYNTH_MISS_PROBA 0.0001
+
+typedef struct replay
+{
+  /* current record */
+  trace_rec_t rec;
+  uint32_t fclk;
+
+  /* replay:<path> */
+  trace_map_t map;
+  size_t i;
+
+  /* synth:<seed> */
+  synth_t synth;
+  uint32_t fdiv;
+  uint64_t time;
+  uint32_t count;
+} replay_t;
+
+static void rec_rd32(dev_handle_t* dev, size_t off, uint32_t* x)
+{
+  replay_t* const r = dev->priv;
+
+  switch (off)
+  {
+  case REG_MAGIC: *x = REG_MAGIC_VALUE; break ;
+  case REG_FCLK: *x = r->fclk; break ;
+  case REG_START: *x = r->rec.start; break ;
+  case REG_NOW: *x = r->rec.now; break ;
+  case REG_COUNT: *x = r->rec.count; break ;
+  default: *x = 0; break ;
+  }
+}
+
+
+/* replay */
+
+static int replay_open(dev_handle_t* dev, const char* path)
+{
+  replay_t* r;
+
+  if (path == NULL) goto on_error_0;
+
+  r = malloc(sizeof(replay_t));
+  if (r == NULL) goto on_error_0;
+  memset(r, 0, sizeof(replay_t));
+
+  if (trace_map_open(&r->map, path))
+  {
+    PERROR();
+    goto on_error_1;
+  }
+
+  r->fclk = r->map.header->fclk;
+  r->i = 0;
+  dev->priv = r;
+
+  return 0;
+
+ on_error_1:
+  free(r);
+ on_error_0:
+  return -1;
+}
+
+static void replay_close(dev_handle_t* dev)
+{
+  replay_t* const r = dev->priv;
+  trace_map_close(&r->map);
+  free(r);
+}
+
+static int replay_wait(dev_handle_t* dev, unsigned int ms, uint32_t* mask)
+{
+  replay_t* const r = dev->priv;
+
+  if (r->i == r->map.nrecs) return 1;
+
+  r->rec = r->map.recs[r->i++];
+  *mask = r->rec.mask;
+
+  return 0;
+}
+
+static void replay_wr32(dev_handle_t* dev, size_t off, uint32_t x)
+{
+  /* the recorded run already configured the device */
+}
+
+const dev_ops_t dev_replay_ops =
+{
+  "replay",
+  1,
+  replay_open,
+  replay_close,
+  replay_wait,
+  rec_rd32,
+  replay_wr32,
+  NULL,
+  NULL,
+  NULL
+};
+
+
+/* synthetic */
+
+static int synth_open(dev_handle_t* dev, const char* seed)
+{
+  replay_t* r;
+
+  r = malloc(sizeof(replay_t));
+  if (r == NULL) return -1;
+  memset(r, 0, sizeof(replay_t));
+
+  synth_init(&r->synth, (seed == NULL) ? 0 : strtoull(seed, NULL, 0));
+  r->fclk = SYNTH_FCLK;
+  dev->priv = r;
+
+  return 0;
+}
+
+static void synth_close(dev_handle_t* dev)
+{
+  free(dev->priv);
+}
+
+static int synth_wait(dev_handle_t* dev, unsigned int ms, uint32_t* mask)
+{
+  replay_t* const r = dev->priv;
+
+  /* not started, the HDL would time out */
+
+  if (r->fdiv == 0)
+  {
+    memset(&r->rec, 0, sizeof(trace_rec_t));
+    *mask = 0;
+    return 0;
+  }
+
+  r->time += r->fdiv;
+  ++r->count;
+
+  if (synth_uniform(&r->synth) < SYNTH_MISS_PROBA)
+  {
+    r->time += r->fdiv;
+    ++r->count;
+  }
+
+  r->rec.start = (uint32_t)r->time;
+  r->rec.now = r->rec.start + synth_lat_ticks(&r->synth, r->fclk);
+  r->rec.count = r->count;
+  r->rec.mask = 1 << 1;
+  *mask = r->rec.mask;
+
+  return 0;
+}
+
+static void synth_wr32(dev_handle_t* dev, size_t off, uint32_t x)
+{
+  replay_t* const r = dev->priv;
+
+  if (off != REG_CTL) return ;
+
+  /* stopping resets the counters */
+
+  r->fdiv = (x & (1 << 31)) ? (x & 0xffffff) : 0;
+  if (r->fdiv == 0) r->count = 0;
+}
+
+const dev_ops_t dev_synth_ops =
+{
+  "synth",
+  1,
+  synth_open,
+  synth_close,
+  synth_wait,
+  rec_rd32,
+  synth_wr32,
+  NULL,
+  NULL,
+  NULL
+};
@@ -0,0 +1,171 @@
+/* virtual time emulation of the HDL */
+
+/* the registers behave as the HDL ones, but time is a 64 bits virtual */
+/* clock that only advances when the realtime task waits or accesses */
+/* registers. a wait jumps to the next IRQ and adds a latency drawn */
+/* from the seeded synth model. if this latency spans several periods, */
+/* the following IRQs are generated meanwhile and REG_COUNT shows them */
+/* as missed, exactly as a late task would see on the HDL. a simulated */
+/* week thus runs in seconds, and two runs with the same seed are */
+/* identical, including REG_NOW wraps. */
+
+/* spec: sim:<seed>[,<fclk_hz>] */
+
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "synth.h"
+#include "dev.h"
+
+
+#define SIM_FCLK 100000000
+
+/* virtual cost of a register access, in ns */
+#define SIM_REG_NS 500
+
+typedef struct sim
+{
+  synth_t synth;
+  uint32_t fclk;
+  uint32_t reg_ticks;
+
+  /* virtual time, in fclk ticks */
+  uint64_t now;
+
+  /* REG_CTL divider, 0 when stopped */
+  uint32_t fdiv;
+  /* time of the next IRQ */
+  uint64_t next;
+  /* REG_START and REG_COUNT */
+  uint64_t start;
+  uint32_t count;
+  /* REG_COUNT when the last wait returned */
+  uint32_t waited;
+} sim_t;
+
+static int sim_open(dev_handle_t* dev, const char* arg)
+{
+  const char* sep;
+  sim_t* sim;
+
+  sim = malloc(sizeof(sim_t));
+  if (sim == NULL) return -1;
+  memset(sim, 0, sizeof(sim_t));
+
+  synth_init(&sim->synth, (arg == NULL) ? 0 : strtoull(arg, NULL, 0));
+
+  sim->fclk = SIM_FCLK;
+  sep = (arg == NULL) ? NULL : strchr(arg, ',');
+  if (sep != NULL) sim->fclk = (uint32_t)strtoul(sep + 1, NULL, 0);
+  if (sim->fclk == 0) sim->fclk = SIM_FCLK;
+
+  sim->reg_ticks = (uint32_t)(((uint64_t)SIM_REG_NS * sim->fclk) / 1000000000);
+
+  dev->priv = sim;
+
+  return 0;
+}
+
+static void sim_close(dev_handle_t* dev)
+{
+  free(dev->priv);
+}
+
+static void generate(sim_t* sim)
+{
+  /* generate the IRQs up to the current time */
+
+  uint64_t n;
+
+  if ((sim->fdiv == 0) || (sim->now < sim->next)) return ;
+
+  n = (sim->now - sim->next) / sim->fdiv + 1;
+  sim->start = sim->next + (n - 1) * sim->fdiv;
+  sim->count += (uint32_t)n;
+  sim->next += n * sim->fdiv;
+}
+
+static int sim_wait(dev_handle_t* dev, unsigned int ms, uint32_t* mask)
+{
+  sim_t* const sim = dev->priv;
+
+  if (sim->fdiv == 0)
+  {
+    sim->now += ((uint64_t)ms * sim->fclk) / 1000;
+    *mask = 0;
+    return 0;
+  }
+
+  /* the next IRQ was already generated while servicing the previous */
+  /* one: it is pending and the task wakes up immediately. otherwise, */
+  /* the task sleeps until the next IRQ, and the latency is drawn for */
+  /* that IRQ only. */
+
+  generate(sim);
+  if (sim->count == sim->waited)
+  {
+    sim->now = sim->next + synth_lat_ticks(&sim->synth, sim->fclk);
+    generate(sim);
+  }
+
+  sim->waited = sim->count;
+  *mask = 1 << 1;
+
+  return 0;
+}
+
+static void sim_rd32(dev_handle_t* dev, size_t off, uint32_t* x)
+{
+  sim_t* const sim = dev->priv;
+
+  sim->now += sim->reg_ticks;
+  generate(sim);
+
+  switch (off)
+  {
+  case REG_MAGIC: *x = REG_MAGIC_VALUE; break ;
+  case REG_FCLK: *x = sim->fclk; break ;
+  case REG_START: *x = (uint32_t)sim->start; break ;
+  case REG_NOW: *x = (uint32_t)sim->now; break ;
+  case REG_COUNT: *x = sim->count; break ;
+  default: *x = 0; break ;
+  }
+}
+
+static void sim_wr32(dev_handle_t* dev, size_t off, uint32_t x)
+{
+  sim_t* const sim = dev->priv;
+
+  sim->now += sim->reg_ticks;
+
+  if (off != REG_CTL) return ;
+
+  if (x & (1 << 31))
+  {
+    sim->fdiv = x & 0xffffff;
+    sim->next = sim->now + sim->fdiv;
+  }
+  else
+  {
+    /* stopping resets the counters */
+    sim->fdiv = 0;
+    sim->count = 0;
+    sim->waited = 0;
+    sim->start = 0;
+  }
+}
+
+const dev_ops_t dev_sim_ops =
+{
+  "sim",
+  1,
+  sim_open,
+  sim_close,
+  sim_wait,
+  sim_rd32,
+  sim_wr32,
+  NULL,
+  NULL,
+  NULL
+};
@@ -0,0 +1,343 @@
+/* HDL device through the standard linux UIO framework */
+
+/* an alternative to libepci and libuirq on hosts without the vendor */
+/* driver stack. the device is bound to uio_pci_generic: the IRQ is */
+/* waited by a read of /dev/uioN, which returns the IRQ count, and is */
+/* reenabled by writing 1 to it before each wait. the registers are */
+/* mapped from the PCI BAR resource files in sysfs. */
+
+/* uio:dummy is a stand-in for hosts without the device. a timerfd */
+/* plays the HDL IRQ generator, the registers are emulated from the */
+/* clock and REG_NOW is CLOCK_MONOTONIC in ns. it runs in real time, */
+/* with a realtime policy, so that the wait path latency of the kernel */
+/* is measured as on the device, timer expiry latency included. */
+
+/* spec: uio:<n>, or uio:dummy */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include "debug.h"
+#include "dev.h"
+
+
+#define REG_BAR 1
+#define REG_BASE 0x80
+
+/* REG_NOW is in ns */
+#define DUMMY_FCLK 1000000000
+
+typedef struct uio
+{
+  /* /dev/uioN, or the timerfd */
+  int fd;
+  unsigned int is_dummy;
+
+  /* uio:<n>, mapped BAR */
+  volatile uint8_t* bar;
+  size_t bar_size;
+
+  /* uio:dummy, emulated registers */
+  uint32_t fdiv;
+  uint64_t t0;
+} uio_t;
+
+static uint64_t get_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static volatile uint8_t* map_bar(int n, unsigned int bar, size_t* size)
+{
+  /* resource files are mapped from offset 0, sized by the file */
+
+  char path[128];
+  void* p;
+  off_t off;
+  int fd;
+
+  snprintf(path, sizeof(path),
+	   "/sys/class/uio/uio%d/device/resource%u", n, bar);
+
+  fd = open(path, O_RDWR | O_SYNC);
+  if (fd == -1) return NULL;
+
+  off = lseek(fd, 0, SEEK_END);
+  if (off <= 0)
+  {
+    close(fd);
+    return NULL;
+  }
+
+  p = mmap(NULL, (size_t)off, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) return NULL;
+
+  *size = (size_t)off;
+  return (volatile uint8_t*)p;
+}
+
+static int enable_ebone_slave_interrupt(int n)
+{
+  /* as in dev_hw.c: ebone slave interrupt enable (bit 9) and global */
+  /* interrupt enable (bit 31) of the bar 0 control register 0 */
+
+  volatile uint8_t* bar0;
+  volatile uint32_t* reg;
+  size_t size;
+
+  bar0 = map_bar(n, 0, &size);
+  if (bar0 == NULL) return -1;
+
+  reg = (volatile uint32_t*)bar0;
+  *reg |= (1 << 31) | (1 << 9);
+
+  munmap((void*)bar0, size);
+
+  return 0;
+}
+
+
+/* uio:<n> */
+
+static int uio_open_dev(uio_t* uio, int n)
+{
+  char path[32];
+
+  if (enable_ebone_slave_interrupt(n))
+  {
+    PERROR();
+    goto on_error_0;
+  }
+
+  uio->bar = map_bar(n, REG_BAR, &uio->bar_size);
+  if (uio->bar == NULL)
+  {
+    PERROR();
+    goto on_error_0;
+  }
+
+  if (uio->bar_size < (REG_BASE + REG_COUNT + sizeof(uint32_t)))
+  {
+    PERROR();
+    goto on_error_1;
+  }
+
+  snprintf(path, sizeof(path), "/dev/uio%d", n);
+  uio->fd = open(path, O_RDWR);
+  if (uio->fd == -1)
+  {
+    PERROR();
+    goto on_error_1;
+  }
+
+  return 0;
+
+ on_error_1:
+  munmap((void*)uio->bar, uio->bar_size);
+ on_error_0:
+  return -1;
+}
+
+static int arm_dev(uio_t* uio)
+{
+  /* uio_pci_generic masks the IRQ in the handler, unmask it */
+
+  static const uint32_t enable = 1;
+
+  if (write(uio->fd, &enable, sizeof(enable)) != sizeof(enable)) return -1;
+
+  return 0;
+}
+
+static int ack_dev(uio_t* uio, uint32_t* mask)
+{
+  /* the IRQ count, unused */
+
+  uint32_t n;
+
+  if (read(uio->fd, &n, sizeof(n)) != sizeof(n)) return -1;
+  *mask = 1 << 1;
+
+  return 0;
+}
+
+
+/* uio:dummy */
+
+static int uio_open_dummy(uio_t* uio)
+{
+  uio->fd = timerfd_create(CLOCK_MONOTONIC, 0);
+  if (uio->fd == -1)
+  {
+    PERROR();
+    return -1;
+  }
+
+  uio->is_dummy = 1;
+
+  return 0;
+}
+
+static int ack_dummy(uio_t* uio, uint32_t* mask)
+{
+  uint64_t n;
+
+  /* expirations since the last read, the count is kept by the clock */
+  if (read(uio->fd, &n, sizeof(n)) != sizeof(n)) return -1;
+  *mask = 1 << 1;
+
+  return 0;
+}
+
+static uint64_t count_dummy(uio_t* uio)
+{
+  /* IRQs generated so far, whether waited or not, as the HDL counter */
+  if (uio->fdiv == 0) return 0;
+  return (get_ns() - uio->t0) / uio->fdiv;
+}
+
+static void rd32_dummy(uio_t* uio, size_t off, uint32_t* x)
+{
+  /* REG_START is the planned expiry time of the last IRQ, as the HDL */
+  /* latches its counter when generating the IRQ */
+
+  switch (off)
+  {
+  case REG_MAGIC: *x = REG_MAGIC_VALUE; break ;
+  case REG_FCLK: *x = DUMMY_FCLK; break ;
+  case REG_START:
+    *x = (uint32_t)(uio->t0 + count_dummy(uio) * uio->fdiv);
+    break ;
+  case REG_NOW: *x = (uint32_t)get_ns(); break ;
+  case REG_COUNT: *x = (uint32_t)count_dummy(uio); break ;
+  default: *x = 0; break ;
+  }
+}
+
+static void wr32_dummy(uio_t* uio, size_t off, uint32_t x)
+{
+  struct itimerspec its;
+  uint64_t t;
+
+  if (off != REG_CTL) return ;
+
+  memset(&its, 0, sizeof(its));
+
+  if (x & (1 << 31))
+  {
+    uio->fdiv = x & 0xffffff;
+    if (uio->fdiv == 0) return ;
+
+    /* absolute times, so that REG_START is exact */
+
+    uio->t0 = get_ns();
+    t = uio->t0 + uio->fdiv;
+    its.it_value.tv_sec = (time_t)(t / 1000000000);
+    its.it_value.tv_nsec = (long)(t % 1000000000);
+    its.it_interval.tv_sec = (time_t)(uio->fdiv / 1000000000);
+    its.it_interval.tv_nsec = (long)(uio->fdiv % 1000000000);
+  }
+  else
+  {
+    /* stopping resets the counters */
+    uio->fdiv = 0;
+    uio->t0 = 0;
+  }
+
+  if (timerfd_settime(uio->fd, TFD_TIMER_ABSTIME, &its, NULL)) PERROR();
+}
+
+
+/* ops */
+
+static int uio_open(dev_handle_t* dev, const char* arg)
+{
+  uio_t* uio;
+  int err;
+
+  if (arg == NULL) return -1;
+
+  uio = malloc(sizeof(uio_t));
+  if (uio == NULL) return -1;
+  memset(uio, 0, sizeof(uio_t));
+
+  if (strcmp(arg, "dummy") == 0) err = uio_open_dummy(uio);
+  else err = uio_open_dev(uio, atoi(arg));
+
+  if (err)
+  {
+    free(uio);
+    return -1;
+  }
+
+  dev->priv = uio;
+
+  return 0;
+}
+
+static void uio_close(dev_handle_t* dev)
+{
+  uio_t* const uio = dev->priv;
+
+  if (uio->is_dummy == 0) munmap((void*)uio->bar, uio->bar_size);
+  close(uio->fd);
+  free(uio);
+}
+
+static int uio_fd(dev_handle_t* dev)
+{
+  uio_t* const uio = dev->priv;
+  return uio->fd;
+}
+
+static int uio_arm(dev_handle_t* dev)
+{
+  uio_t* const uio = dev->priv;
+  if (uio->is_dummy) return 0;
+  return arm_dev(uio);
+}
+
+static int uio_ack(dev_handle_t* dev, uint32_t* mask)
+{
+  uio_t* const uio = dev->priv;
+  if (uio->is_dummy) return ack_dummy(uio, mask);
+  return ack_dev(uio, mask);
+}
+
+static void uio_rd32(dev_handle_t* dev, size_t off, uint32_t* x)
+{
+  uio_t* const uio = dev->priv;
+  if (uio->is_dummy) rd32_dummy(uio, off, x);
+  else *x = *(volatile uint32_t*)(uio->bar + REG_BASE + off);
+}
+
+static void uio_wr32(dev_handle_t* dev, size_t off, uint32_t x)
+{
+  uio_t* const uio = dev->priv;
+  if (uio->is_dummy) wr32_dummy(uio, off, x);
+  else *(volatile uint32_t*)(uio->bar + REG_BASE + off) = x;
+}
+
+const dev_ops_t dev_uio_ops =
+{
+  "uio",
+  0,
+  uio_open,
+  uio_close,
+  dev_fd_wait,
+  uio_rd32,
+  uio_wr32,
+  uio_fd,
+  uio_arm,
+  uio_ack
+};
@@ -0,0 +1,318 @@
+/* HDL device through VFIO */
+
+/* the device is bound to vfio-pci. BAR 1 is mapped through the device */
+/* fd, and the IRQ is signaled on an eventfd: MSI if the device has */
+/* it, else INTx, which vfio-pci masks on each IRQ and which is */
+/* unmasked before each wait. vfio-pci does not enable bus mastering, */
+/* without which MSI writes of the device never arrive: it is set in */
+/* the PCI command register through the config region. */
+
+/* spec: vfio:<group>,<bdf>, ie. vfio:12,0000:03:00.0 */
+
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <linux/vfio.h>
+#include <linux/pci_regs.h>
+#include "debug.h"
+#include "dev.h"
+
+
+#define REG_BAR VFIO_PCI_BAR1_REGION_INDEX
+#define REG_BASE 0x80
+
+typedef struct vfio
+{
+  int container;
+  int group;
+  int device;
+  int efd;
+  /* VFIO_PCI_MSI_IRQ_INDEX or VFIO_PCI_INTX_IRQ_INDEX */
+  uint32_t irq_index;
+  volatile uint8_t* bar;
+  size_t bar_size;
+} vfio_t;
+
+static volatile uint8_t* map_region(int device, uint32_t index, size_t* size)
+{
+  struct vfio_region_info info;
+  void* p;
+
+  memset(&info, 0, sizeof(info));
+  info.argsz = sizeof(info);
+  info.index = index;
+  if (ioctl(device, VFIO_DEVICE_GET_REGION_INFO, &info)) return NULL;
+  if ((info.flags & VFIO_REGION_INFO_FLAG_MMAP) == 0) return NULL;
+
+  p = mmap(NULL, (size_t)info.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+	   device, (off_t)info.offset);
+  if (p == MAP_FAILED) return NULL;
+
+  *size = (size_t)info.size;
+  return (volatile uint8_t*)p;
+}
+
+static int enable_ebone_slave_interrupt(int device)
+{
+  /* as in dev_hw.c: ebone slave interrupt enable (bit 9) and global */
+  /* interrupt enable (bit 31) of the bar 0 control register 0 */
+
+  volatile uint8_t* bar0;
+  volatile uint32_t* reg;
+  size_t size;
+
+  bar0 = map_region(device, VFIO_PCI_BAR0_REGION_INDEX, &size);
+  if (bar0 == NULL) return -1;
+
+  reg = (volatile uint32_t*)bar0;
+  *reg |= (1 << 31) | (1 << 9);
+
+  munmap((void*)bar0, size);
+
+  return 0;
+}
+
+static int enable_bus_master(int device)
+{
+  struct vfio_region_info info;
+  const off_t off_cmd = PCI_COMMAND;
+  uint16_t cmd;
+
+  memset(&info, 0, sizeof(info));
+  info.argsz = sizeof(info);
+  info.index = VFIO_PCI_CONFIG_REGION_INDEX;
+  if (ioctl(device, VFIO_DEVICE_GET_REGION_INFO, &info)) return -1;
+
+  if (pread(device, &cmd, sizeof(cmd), (off_t)info.offset + off_cmd) !=
+      sizeof(cmd))
+    return -1;
+  cmd |= PCI_COMMAND_MASTER;
+  if (pwrite(device, &cmd, sizeof(cmd), (off_t)info.offset + off_cmd) !=
+      sizeof(cmd))
+    return -1;
+
+  return 0;
+}
+
+static int set_irqs
+(vfio_t* vfio, uint32_t flags, size_t count, const int32_t* fd)
+{
+  uint8_t buf[sizeof(struct vfio_irq_set) + sizeof(int32_t)];
+  struct vfio_irq_set* const set = (struct vfio_irq_set*)buf;
+
+  set->argsz = (uint32_t)sizeof(struct vfio_irq_set);
+  if (fd != NULL) set->argsz += (uint32_t)sizeof(int32_t);
+  set->flags = flags;
+  if (fd != NULL) set->flags |= VFIO_IRQ_SET_DATA_EVENTFD;
+  else set->flags |= VFIO_IRQ_SET_DATA_NONE;
+  set->index = vfio->irq_index;
+  set->start = 0;
+  set->count = (uint32_t)count;
+  if (fd != NULL) memcpy(set->data, fd, sizeof(int32_t));
+
+  return ioctl(vfio->device, VFIO_DEVICE_SET_IRQS, set) ? -1 : 0;
+}
+
+static int vfio_open(dev_handle_t* dev, const char* arg)
+{
+  struct vfio_group_status status;
+  struct vfio_irq_info irq;
+  const char* bdf;
+  char path[64];
+  vfio_t* vfio;
+  int32_t efd;
+
+  if (arg == NULL) goto on_error_0;
+  bdf = strchr(arg, ',');
+  if (bdf == NULL) goto on_error_0;
+  ++bdf;
+
+  vfio = malloc(sizeof(vfio_t));
+  if (vfio == NULL) goto on_error_0;
+
+  vfio->container = open("/dev/vfio/vfio", O_RDWR);
+  if (vfio->container == -1)
+  {
+    PERROR();
+    goto on_error_1;
+  }
+
+  if (ioctl(vfio->container, VFIO_GET_API_VERSION) != VFIO_API_VERSION)
+  {
+    PERROR();
+    goto on_error_2;
+  }
+
+  snprintf(path, sizeof(path), "/dev/vfio/%d", atoi(arg));
+  vfio->group = open(path, O_RDWR);
+  if (vfio->group == -1)
+  {
+    PERROR();
+    goto on_error_2;
+  }
+
+  /* all the devices of the group must be bound to vfio */
+
+  memset(&status, 0, sizeof(status));
+  status.argsz = sizeof(status);
+  if (ioctl(vfio->group, VFIO_GROUP_GET_STATUS, &status) ||
+      ((status.flags & VFIO_GROUP_FLAGS_VIABLE) == 0))
+  {
+    PERROR();
+    goto on_error_3;
+  }
+
+  if (ioctl(vfio->group, VFIO_GROUP_SET_CONTAINER, &vfio->container) ||
+      ioctl(vfio->container, VFIO_SET_IOMMU, VFIO_TYPE1_IOMMU))
+  {
+    PERROR();
+    goto on_error_3;
+  }
+
+  vfio->device = ioctl(vfio->group, VFIO_GROUP_GET_DEVICE_FD, bdf);
+  if (vfio->device < 0)
+  {
+    PERROR();
+    goto on_error_3;
+  }
+
+  if (enable_ebone_slave_interrupt(vfio->device))
+  {
+    PERROR();
+    goto on_error_4;
+  }
+
+  vfio->bar = map_region(vfio->device, REG_BAR, &vfio->bar_size);
+  if (vfio->bar == NULL)
+  {
+    PERROR();
+    goto on_error_4;
+  }
+
+  if (vfio->bar_size < (REG_BASE + REG_COUNT + sizeof(uint32_t)))
+  {
+    PERROR();
+    goto on_error_5;
+  }
+
+  /* MSI if available */
+
+  memset(&irq, 0, sizeof(irq));
+  irq.argsz = sizeof(irq);
+  irq.index = VFIO_PCI_MSI_IRQ_INDEX;
+  if (ioctl(vfio->device, VFIO_DEVICE_GET_IRQ_INFO, &irq) || (irq.count == 0))
+    irq.index = VFIO_PCI_INTX_IRQ_INDEX;
+  vfio->irq_index = irq.index;
+
+  if ((irq.index == VFIO_PCI_MSI_IRQ_INDEX) && enable_bus_master(vfio->device))
+  {
+    PERROR();
+    goto on_error_5;
+  }
+
+  vfio->efd = eventfd(0, 0);
+  if (vfio->efd == -1)
+  {
+    PERROR();
+    goto on_error_5;
+  }
+
+  efd = vfio->efd;
+  if (set_irqs(vfio, VFIO_IRQ_SET_ACTION_TRIGGER, 1, &efd))
+  {
+    PERROR();
+    goto on_error_6;
+  }
+
+  dev->priv = vfio;
+
+  return 0;
+
+ on_error_6:
+  close(vfio->efd);
+ on_error_5:
+  munmap((void*)vfio->bar, vfio->bar_size);
+ on_error_4:
+  close(vfio->device);
+ on_error_3:
+  close(vfio->group);
+ on_error_2:
+  close(vfio->container);
+ on_error_1:
+  free(vfio);
+ on_error_0:
+  return -1;
+}
+
+static void vfio_close(dev_handle_t* dev)
+{
+  vfio_t* const vfio = dev->priv;
+
+  set_irqs(vfio, VFIO_IRQ_SET_ACTION_TRIGGER, 0, NULL);
+  close(vfio->efd);
+  munmap((void*)vfio->bar, vfio->bar_size);
+  close(vfio->device);
+  close(vfio->group);
+  close(vfio->container);
+  free(vfio);
+}
+
+static int vfio_fd(dev_handle_t* dev)
+{
+  vfio_t* const vfio = dev->priv;
+  return vfio->efd;
+}
+
+static int vfio_arm(dev_handle_t* dev)
+{
+  /* vfio-pci masks INTx in the handler, unmask it */
+
+  vfio_t* const vfio = dev->priv;
+
+  if (vfio->irq_index != VFIO_PCI_INTX_IRQ_INDEX) return 0;
+  return set_irqs(vfio, VFIO_IRQ_SET_ACTION_UNMASK, 1, NULL);
+}
+
+static int vfio_ack(dev_handle_t* dev, uint32_t* mask)
+{
+  vfio_t* const vfio = dev->priv;
+  uint64_t n;
+
+  if (read(vfio->efd, &n, sizeof(n)) != sizeof(n)) return -1;
+  *mask = 1 << 1;
+
+  return 0;
+}
+
+static void vfio_rd32(dev_handle_t* dev, size_t off, uint32_t* x)
+{
+  vfio_t* const vfio = dev->priv;
+  *x = *(volatile uint32_t*)(vfio->bar + REG_BASE + off);
+}
+
+static void vfio_wr32(dev_handle_t* dev, size_t off, uint32_t x)
+{
+  vfio_t* const vfio = dev->priv;
+  *(volatile uint32_t*)(vfio->bar + REG_BASE + off) = x;
+}
+
+const dev_ops_t dev_vfio_ops =
+{
+  "vfio",
+  0,
+  vfio_open,
+  vfio_close,
+  dev_fd_wait,
+  vfio_rd32,
+  vfio_wr32,
+  vfio_fd,
+  vfio_arm,
+  vfio_ack
+};
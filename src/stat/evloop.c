@@ -0,0 +1,208 @@
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include "debug.h"
+#include "dev.h"
+#include "evloop.h"
+
+
+/* other event rates, not multiple of the usual IRQ frequencies so that */
+/* the events do not stay in phase with the IRQ */
+#define EVLOOP_TIMER_HZ 997
+#define EVLOOP_FEEDER_HZ 101
+
+/* epoll_event.data.u32 */
+#define EVLOOP_ID_DEV 0
+#define EVLOOP_ID_TIMER 1
+#define EVLOOP_ID_SOCKET 2
+
+
+/* feeder */
+
+static void* feeder_main(void* args)
+{
+  evloop_feeder_t* const f = (evloop_feeder_t*)args;
+  const uint8_t x = 0x2a;
+  struct timespec ts;
+
+  ts.tv_sec = 0;
+  ts.tv_nsec = 1000000000 / EVLOOP_FEEDER_HZ;
+
+  while (f->is_done == 0)
+  {
+    if (send(f->sfd[1], &x, sizeof(x), MSG_DONTWAIT) == -1) { /* full */ }
+    nanosleep(&ts, NULL);
+  }
+
+  return NULL;
+}
+
+int evloop_feeder_start(evloop_feeder_t* f, int cpu)
+{
+  /* called from the main thread. the feeder must inherit neither the */
+  /* realtime policy nor the realtime placement: it gets the affinity */
+  /* and the cgroup of the calling thread, without cpu if not -1 */
+
+  struct sched_param param;
+  pthread_attr_t attr;
+  cpu_set_t set;
+
+  f->is_done = 0;
+
+  if (socketpair(AF_UNIX, SOCK_DGRAM, 0, f->sfd)) goto on_error_0;
+
+  if (pthread_attr_init(&attr)) goto on_error_1;
+  param.sched_priority = 0;
+  pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+  pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+  pthread_attr_setschedparam(&attr, &param);
+
+  /* a single cpu machine has no other cpu to run it on */
+
+  if (sched_getaffinity(0, sizeof(set), &set)) goto on_error_2;
+  if (cpu >= 0) CPU_CLR(cpu, &set);
+  if (CPU_COUNT(&set) && pthread_attr_setaffinity_np(&attr, sizeof(set), &set))
+    goto on_error_2;
+
+  if (pthread_create(&f->thread, &attr, feeder_main, f)) goto on_error_2;
+  pthread_attr_destroy(&attr);
+
+  return 0;
+
+ on_error_2:
+  pthread_attr_destroy(&attr);
+ on_error_1:
+  close(f->sfd[0]);
+  close(f->sfd[1]);
+ on_error_0:
+  return -1;
+}
+
+void evloop_feeder_stop(evloop_feeder_t* f)
+{
+  f->is_done = 1;
+  pthread_join(f->thread, NULL);
+  close(f->sfd[0]);
+  close(f->sfd[1]);
+}
+
+
+/* event loop */
+
+static int add_fd(evloop_t* loop, int fd, uint32_t id)
+{
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.u32 = id;
+  return epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &ev) ? -1 : 0;
+}
+
+int evloop_open(evloop_t* loop, dev_handle_t* dev, const evloop_feeder_t* f)
+{
+  struct itimerspec its;
+
+  loop->dev = dev;
+  loop->sfd = f->sfd[0];
+  loop->nothers = 0;
+
+  if (dev_fd(dev) == -1)
+  {
+    PERROR();
+    goto on_error_0;
+  }
+
+  loop->epfd = epoll_create1(0);
+  if (loop->epfd == -1) goto on_error_0;
+
+  if (add_fd(loop, dev_fd(dev), EVLOOP_ID_DEV)) goto on_error_1;
+
+  /* timer */
+
+  loop->tfd = timerfd_create(CLOCK_MONOTONIC, 0);
+  if (loop->tfd == -1) goto on_error_1;
+
+  its.it_value.tv_sec = 0;
+  its.it_value.tv_nsec = 1000000000 / EVLOOP_TIMER_HZ;
+  its.it_interval = its.it_value;
+  if (timerfd_settime(loop->tfd, 0, &its, NULL)) goto on_error_2;
+  if (add_fd(loop, loop->tfd, EVLOOP_ID_TIMER)) goto on_error_2;
+
+  /* socket */
+
+  if (add_fd(loop, loop->sfd, EVLOOP_ID_SOCKET)) goto on_error_2;
+
+  return 0;
+
+ on_error_2:
+  close(loop->tfd);
+ on_error_1:
+  close(loop->epfd);
+ on_error_0:
+  return -1;
+}
+
+void evloop_close(evloop_t* loop)
+{
+  close(loop->tfd);
+  close(loop->epfd);
+}
+
+int evloop_wait(evloop_t* loop, unsigned int ms, uint32_t* mask)
+{
+  /* same semantics as dev_wait. the timeout is restarted by the other */
+  /* events, as in most event loops */
+
+  struct epoll_event evs[3];
+  uint64_t x;
+  uint8_t c;
+  int n;
+  int i;
+
+  if (dev_arm(loop->dev)) return -1;
+
+  while (1)
+  {
+    n = epoll_wait(loop->epfd, evs, 3, (int)ms);
+    if (n == -1) return -1;
+
+    *mask = 0;
+    if (n == 0) return 0;
+
+    /* other events first: the worst case of a loop dispatching the */
+    /* ready fds in any order */
+
+    for (i = 0; i != n; ++i)
+    {
+      switch (evs[i].data.u32)
+      {
+      case EVLOOP_ID_TIMER:
+	if (read(loop->tfd, &x, sizeof(x)) != sizeof(x)) return -1;
+	++loop->nothers;
+	break ;
+
+      case EVLOOP_ID_SOCKET:
+	if (recv(loop->sfd, &c, sizeof(c), MSG_DONTWAIT) == -1) return -1;
+	++loop->nothers;
+	break ;
+
+      default: break ;
+      }
+    }
+
+    for (i = 0; i != n; ++i)
+    {
+      if (evs[i].data.u32 == EVLOOP_ID_DEV) return dev_ack(loop->dev, mask);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,49 @@
+#ifndef EVLOOP_H_INCLUDED
+#define EVLOOP_H_INCLUDED
+
+
+/* IRQ wait multiplexed in an epoll event loop, as in applications that */
+/* wait on many fds at once. the device IRQ fd is registered with */
+/* other fds, a periodic timerfd and a socket fed by a non realtime */
+/* thread, whose events are handled and the wait resumed until the */
+/* IRQ fd is ready. */
+
+/* the feeder is started by the main thread around each run of the */
+/* realtime task, so that it runs with the placement of the main */
+/* thread, off the realtime cpu and outside the isolated partition. */
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "dev.h"
+
+
+typedef struct evloop_feeder
+{
+  /* socket pair, the feeder thread writes to sfd[1] */
+  int sfd[2];
+  pthread_t thread;
+  volatile unsigned int is_done;
+} evloop_feeder_t;
+
+int evloop_feeder_start(evloop_feeder_t*, int);
+void evloop_feeder_stop(evloop_feeder_t*);
+
+typedef struct evloop
+{
+  dev_handle_t* dev;
+  int epfd;
+  int tfd;
+  /* read side of the feeder socket */
+  int sfd;
+  /* events of the other fds */
+  size_t nothers;
+} evloop_t;
+
+int evloop_open(evloop_t*, dev_handle_t*, const evloop_feeder_t*);
+void evloop_close(evloop_t*);
+int evloop_wait(evloop_t*, unsigned int, uint32_t*);
+
+
+#endif /* EVLOOP_H_INCLUDED */
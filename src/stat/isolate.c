@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include "cgroup.h"
+#include "debug.h"
+#include "isolate.h"
+
+
+#define ISOLATE_DOMAIN "rtbench_iso"
+#define ISOLATE_CGROUP ISOLATE_DOMAIN "/rt"
+
+
+/* IRQ affinity */
+
+static int irq_path(char* buf, size_t size, int irq)
+{
+  const int n = snprintf(buf, size, "/proc/irq/%d/smp_affinity_list", irq);
+  return ((n < 0) || ((size_t)n >= size)) ? -1 : 0;
+}
+
+int irq_get_cpus(int irq, char* buf, size_t size)
+{
+  char path[64];
+  FILE* file;
+  int err = -1;
+
+  if (irq_path(path, sizeof(path), irq)) return -1;
+  file = fopen(path, "r");
+  if (file == NULL) return -1;
+  if (fgets(buf, (int)size, file) != NULL)
+  {
+    buf[strcspn(buf, "\n")] = 0;
+    err = 0;
+  }
+  fclose(file);
+
+  return err;
+}
+
+int irq_set_cpus(int irq, const char* cpus)
+{
+  char path[64];
+  FILE* file;
+  int err = -1;
+
+  if (irq_path(path, sizeof(path), irq)) return -1;
+  file = fopen(path, "w");
+  if (file == NULL) return -1;
+  if (fputs(cpus, file) >= 0) err = 0;
+  if (fclose(file)) err = -1;
+
+  return err;
+}
+
+/* partition */
+
+int isolate_open(isolate_t* iso, const char* cpus, int irq)
+{
+  char buf[64];
+
+  iso->irq = irq;
+
+  if (cgroup_self(iso->home, sizeof(iso->home))) goto on_error_0;
+  if ((irq >= 0) && irq_get_cpus(irq, iso->irq_cpus, sizeof(iso->irq_cpus)))
+    goto on_error_0;
+
+  /* the domain holds the process, the partition is its threaded child */
+  /* and holds the realtime thread only. the partition is not a child */
+  /* of a partition root: recent kernels make it a remote partition, */
+  /* which needs the cpus exclusive in every ancestor */
+
+  cgroup_enable("", "cpuset");
+  if (cgroup_create(ISOLATE_DOMAIN)) goto on_error_0;
+  cgroup_write(ISOLATE_DOMAIN, "cpuset.cpus.exclusive", cpus);
+  if (cgroup_enable(ISOLATE_DOMAIN, "cpuset")) goto on_error_1;
+
+  if (cgroup_create(ISOLATE_CGROUP)) goto on_error_1;
+  if (cgroup_write(ISOLATE_CGROUP, "cgroup.type", "threaded")) goto on_error_2;
+  if (cgroup_write(ISOLATE_CGROUP, "cpuset.cpus", cpus)) goto on_error_2;
+
+  /* exclusive cpus are required by recent kernels, older ones lack */
+  /* the file and take cpuset.cpus as is */
+
+  cgroup_write(ISOLATE_CGROUP, "cpuset.cpus.exclusive", cpus);
+
+  /* the kernel accepts invalid partitions, and reports them */
+  /* as 'isolated invalid (<reason>)' */
+
+  if (cgroup_write(ISOLATE_CGROUP, "cpuset.cpus.partition", "isolated"))
+    goto on_error_2;
+  if (cgroup_read(ISOLATE_CGROUP, "cpuset.cpus.partition", buf, sizeof(buf)))
+    goto on_error_3;
+  if (strcmp(buf, "isolated"))
+  {
+    printf("[!] partition: %s\n", buf);
+    goto on_error_3;
+  }
+
+  return 0;
+
+ on_error_3:
+  cgroup_write(ISOLATE_CGROUP, "cpuset.cpus.partition", "member");
+ on_error_2:
+  cgroup_destroy(ISOLATE_CGROUP);
+ on_error_1:
+  cgroup_destroy(ISOLATE_DOMAIN);
+ on_error_0:
+  return -1;
+}
+
+void isolate_close(isolate_t* iso)
+{
+  cgroup_write(ISOLATE_CGROUP, "cpuset.cpus.partition", "member");
+  cgroup_destroy(ISOLATE_CGROUP);
+  cgroup_destroy(ISOLATE_DOMAIN);
+}
+
+int isolate_enter(isolate_t* iso)
+{
+  /* the process moves to the domain, whose effective cpus exclude the */
+  /* partition ones. the threaded IRQ handlers stay in the root group, */
+  /* which they cannot leave for another threaded subtree, but their */
+  /* affinity follows the IRQ one */
+
+  char cpus[256];
+
+  if (cgroup_attach(ISOLATE_DOMAIN, getpid())) return -1;
+
+  if (iso->irq >= 0)
+  {
+    if (cgroup_read
+	(ISOLATE_CGROUP, "cpuset.cpus.effective", cpus, sizeof(cpus)))
+      goto on_error;
+    if (irq_set_cpus(iso->irq, cpus)) goto on_error;
+  }
+
+  return 0;
+
+ on_error:
+  cgroup_attach(iso->home, getpid());
+  return -1;
+}
+
+int isolate_enter_thread(isolate_t* iso)
+{
+  /* the calling thread, once the process entered */
+  return cgroup_attach_thread(ISOLATE_CGROUP, (pid_t)syscall(SYS_gettid));
+}
+
+void isolate_leave(isolate_t* iso)
+{
+  /* the partition thread, if still alive, moves back with the process */
+
+  if (iso->irq >= 0) irq_set_cpus(iso->irq, iso->irq_cpus);
+  cgroup_attach(iso->home, getpid());
+}
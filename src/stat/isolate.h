@@ -0,0 +1,39 @@
+#ifndef ISOLATE_H_INCLUDED
+#define ISOLATE_H_INCLUDED
+
+
+/* runtime isolated cpuset partition for the realtime task and the */
+/* device IRQ, as an alternative to the isolcpus boot parameter. the */
+/* process enters a cgroup whose threaded child is the partition, and */
+/* only the realtime thread enters the partition, so that the other */
+/* threads (rtlog drain, trace writer) run on the remaining cpus */
+
+
+#include <stddef.h>
+#include "cgroup.h"
+
+
+typedef struct isolate
+{
+  /* device IRQ number, or -1 */
+  int irq;
+  /* cgroup of the process before entering the partition */
+  char home[CGROUP_PATH_SIZE];
+  /* IRQ affinity before entering the partition */
+  char irq_cpus[256];
+} isolate_t;
+
+int isolate_open(isolate_t*, const char*, int);
+void isolate_close(isolate_t*);
+int isolate_enter(isolate_t*);
+int isolate_enter_thread(isolate_t*);
+void isolate_leave(isolate_t*);
+
+
+/* IRQ affinity, /proc/irq/<irq>/smp_affinity_list */
+
+int irq_get_cpus(int, char*, size_t);
+int irq_set_cpus(int, const char*);
+
+
+#endif /* ISOLATE_H_INCLUDED */
@@ -18,32 +18,30 @@
 /* REG_COUNT (ronly): number of IRQ generated so far */
 
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <unistd.h>
+#include <time.h>
 #include <sched.h>
 #include <pthread.h>
 #include <sys/types.h>
-#include "libuirq.h"
-#include "libepci.h"
-
-
-#define CONFIG_DEBUG 1
-#if (CONFIG_DEBUG == 1)
-#include <stdio.h>
-#define ASSUME(__x) \
-do { if (!(__x)) printf("[!] %d\n", __LINE__); } while (0)
-#define PRINTF(__s, ...) \
-do { printf(__s, ## __VA_ARGS__); } while (0)
-#define PERROR() \
-do { printf("[!] %s,%d\n", __FILE__, __LINE__); } while (0)
-#else
-#define ASSUME(__x)
-#define PRINTF(__s, ...)
-#define PERROR()
-#endif
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "hist.h"
+#include "trace.h"
+#include "debug.h"
+#include "rtlog.h"
+#include "dev.h"
+#include "isolate.h"
+#include "numa.h"
+#include "rtmem.h"
+#include "perf.h"
+#include "bench.h"
+#include "waiter.h"
 
 
 /* command line parsing */
@@ -52,6 +50,18 @@ typedef struct cmdline
 {
   uint32_t irq_fgen;
   uint32_t irq_count;
+  const char* trace_path;
+  const char* dev_spec;
+  const char* isolate_cpus;
+  int irq;
+  int cpu;
+  const char* irq_cpus;
+  int mem_node;
+  unsigned int is_hugepages;
+  unsigned int is_bench;
+  unsigned int wait_mode;
+  int wait_cpu;
+  unsigned int is_batch;
 } cmdline_t;
 
 static uint32_t get_num(const char* s)
@@ -65,6 +75,27 @@ static int get_cmdline(cmdline_t* cmd, size_t ac, char** av)
 {
   /* -freq <freq_hz>: the IRQ generation frequency */
   /* -count <count>: how many IRQ to generate. 0 or none is infinit. */
+  /* -trace <path>: record every sample in a trace file */
+  /* -dev <spec>: event source, hw (default), replay:<path>, synth:<seed>, */
+  /* sim:<seed>[,<fclk>], uio:<n>|dummy, vfio:<group>,<bdf>. see dev.h */
+  /* -isolate <cpus>: run once outside, then once inside a runtime */
+  /* created isolated cpuset partition. the trace covers the latter. */
+  /* -irq <irq>: the device IRQ, moved with -isolate or -irq_cpu */
+  /* -cpu <cpu>: pin the realtime task. -1 or none is not pinned. */
+  /* -irq_cpu <cpus>: the device IRQ affinity during the run, needs -irq */
+  /* -mem_node <node>: numa node of the realtime task memory. default */
+  /* is the node of -cpu, or not bound if -cpu is not given. */
+  /* -hugepages <0|1>: back the realtime memory with huge pages */
+  /* -bench <0|1>: measure the overhead of stat itself instead, -count */
+  /* samples per benchmark. see bench.h */
+  /* -wait <mode>: IRQ wait, direct (default) in the device wait call, */
+  /* epoll in an event loop with other fds (evloop.h), uring or */
+  /* uring_sqpoll through io_uring (uring.h), or busy spinning on */
+  /* REG_COUNT without IRQ. all but direct and busy need a source with */
+  /* an IRQ fd (uio, vfio). offline sources are waited directly. */
+  /* -wait_cpu <cpu>: pin the uring_sqpoll kernel thread, away from -cpu */
+  /* -batch <0|1>: service every IRQ generated since the last wake, */
+  /* instead of counting all but the last one as missed */
 
   size_t i;
 
@@ -72,14 +103,53 @@ static int get_cmdline(cmdline_t* cmd, size_t ac, char** av)
 
   cmd->irq_fgen = 1000;
   cmd->irq_count = 0;
+  cmd->trace_path = NULL;
+  cmd->dev_spec = "hw";
+  cmd->isolate_cpus = NULL;
+  cmd->irq = -1;
+  cmd->cpu = -1;
+  cmd->irq_cpus = NULL;
+  cmd->mem_node = -2;
+  cmd->is_hugepages = 0;
+  cmd->is_bench = 0;
+  cmd->wait_mode = WAIT_DIRECT;
+  cmd->wait_cpu = -1;
+  cmd->is_batch = 0;
 
   for (i = 0; i != ac; i += 2)
   {
     if (strcmp(av[i], "-freq") == 0) cmd->irq_fgen = get_num(av[i + 1]);
     else if (strcmp(av[i], "-count") == 0) cmd->irq_count = get_num(av[i + 1]);
+    else if (strcmp(av[i], "-trace") == 0) cmd->trace_path = av[i + 1];
+    else if (strcmp(av[i], "-dev") == 0) cmd->dev_spec = av[i + 1];
+    else if (strcmp(av[i], "-isolate") == 0) cmd->isolate_cpus = av[i + 1];
+    else if (strcmp(av[i], "-irq") == 0) cmd->irq = (int)get_num(av[i + 1]);
+    else if (strcmp(av[i], "-cpu") == 0) cmd->cpu = atoi(av[i + 1]);
+    else if (strcmp(av[i], "-irq_cpu") == 0) cmd->irq_cpus = av[i + 1];
+    else if (strcmp(av[i], "-mem_node") == 0) cmd->mem_node = atoi(av[i + 1]);
+    else if (strcmp(av[i], "-hugepages") == 0)
+      cmd->is_hugepages = get_num(av[i + 1]);
+    else if (strcmp(av[i], "-bench") == 0) cmd->is_bench = get_num(av[i + 1]);
+    else if (strcmp(av[i], "-wait") == 0)
+    {
+      if (waiter_find_mode(av[i + 1], &cmd->wait_mode)) goto on_error;
+    }
+    else if (strcmp(av[i], "-wait_cpu") == 0) cmd->wait_cpu = atoi(av[i + 1]);
+    else if (strcmp(av[i], "-batch") == 0) cmd->is_batch = get_num(av[i + 1]);
     else goto on_error;
   }
 
+  if ((cmd->irq_cpus != NULL) && (cmd->irq < 0)) goto on_error;
+
+  /* -1 if the kernel has no numa support */
+  if (cmd->mem_node == -2)
+    cmd->mem_node = (cmd->cpu >= 0) ? numa_cpu_node(cmd->cpu) : -1;
+
+  if (dev_find(cmd->dev_spec) == NULL) goto on_error;
+
+  if ((cmd->wait_mode != WAIT_DIRECT) && dev_find(cmd->dev_spec)->is_offline)
+    goto on_error;
+
   return 0;
  on_error:
   return -1;
@@ -92,6 +162,13 @@ typedef struct rtask
 {
   int (*fn)(void*);
   void* args;
+  int policy;
+  int cpu;
+  int node;
+  /* partition entered by the thread, or NULL */
+  isolate_t* iso;
+  /* epoll feeder, started by the caller around the run, or NULL */
+  evloop_feeder_t* feeder;
   pthread_t thread;
   int err;
 } rtask_handle_t;
@@ -108,13 +185,35 @@ static void* rtask_entry(void* args)
   /* note: setting the thread scheduling priority in pthread_create */
   /* attributes did not work, so we do this here */
 
-  static const int policy = SCHED_FIFO;
+  /* note: offline event sources use SCHED_OTHER, and run unprivileged */
+
+  const int policy = rtask->policy;
   struct sched_param param;
+  cpu_set_t set;
 
   rtask->err = -1;
 
-  param.sched_priority = sched_get_priority_max(policy);
-  if (pthread_setschedparam(pthread_self(), policy, &param)) goto on_error;
+  /* the partition first, the cpu may be one of its cpus */
+
+  if ((rtask->iso != NULL) && isolate_enter_thread(rtask->iso)) goto on_error;
+
+  if (rtask->cpu >= 0)
+  {
+    CPU_ZERO(&set);
+    CPU_SET(rtask->cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+      goto on_error;
+  }
+
+  /* stack and later allocations on the node of the realtime memory */
+
+  if ((rtask->node >= 0) && numa_bind_thread(rtask->node)) goto on_error;
+
+  if (policy != SCHED_OTHER)
+  {
+    param.sched_priority = sched_get_priority_max(policy);
+    if (pthread_setschedparam(pthread_self(), policy, &param)) goto on_error;
+  }
 
   rtask->err = rtask->fn(rtask->args);
 
@@ -122,11 +221,27 @@ static void* rtask_entry(void* args)
   return NULL;
 }
 
-static int rtask_start(rtask_handle_t* rtask, int (*fn)(void*), void* args)
+static int rtask_start
+(rtask_handle_t* rtask, int (*fn)(void*), void* args,
+ int policy, int cpu, int node, isolate_t* iso)
 {
   rtask->fn = fn;
   rtask->args = args;
-  pthread_create(&rtask->thread, NULL, rtask_entry, rtask);
+  rtask->policy = policy;
+  rtask->cpu = cpu;
+  rtask->node = node;
+  rtask->iso = iso;
+
+  /* the feeder keeps the calling thread placement, minus the cpu */
+
+  if ((rtask->feeder != NULL) && evloop_feeder_start(rtask->feeder, cpu))
+    return -1;
+
+  if (pthread_create(&rtask->thread, NULL, rtask_entry, rtask))
+  {
+    if (rtask->feeder != NULL) evloop_feeder_stop(rtask->feeder);
+    return -1;
+  }
 
   return 0;
 }
@@ -134,67 +249,57 @@ static int rtask_start(rtask_handle_t* rtask, int (*fn)(void*), void* args)
 static int rtask_wait(rtask_handle_t* rtask)
 {
   pthread_join(rtask->thread, NULL);
+  if (rtask->feeder != NULL) evloop_feeder_stop(rtask->feeder);
   return rtask->err;
 }
 
 
 /* register access */
 
-#define REG_BAR 0x01
-#define REG_BASE 0x80
-#define REG_CTL 0x00
-#define REG_TOGL 0x08
-#define REG_MAGIC 0x0c
-#define REG_FCLK 0x10
-#define REG_START 0x14
-#define REG_NOW 0x18
-#define REG_COUNT 0x1c
-
-static void reg_write(epcihandle_t epci, size_t off, uint32_t x)
+static void reg_write(dev_handle_t* dev, size_t off, uint32_t x)
 {
-  epci_wr32_reg(epci, REG_BASE + off, x);
+  dev_wr32(dev, off, x);
 }
 
-static void reg_read(epcihandle_t epci, size_t off, uint32_t* x)
+static void reg_read(dev_handle_t* dev, size_t off, uint32_t* x)
 {
-  epci_rd32_reg(epci, REG_BASE + off, x);
+  dev_rd32(dev, off, x);
 }
 
 __attribute__((unused))
-static void reg_read_togl(epcihandle_t epci, uint32_t* x)
+static void reg_read_togl(dev_handle_t* dev, uint32_t* x)
 {
-  reg_read(epci, REG_TOGL, x);
+  reg_read(dev, REG_TOGL, x);
 }
 
-static void reg_read_magic(epcihandle_t epci, uint32_t* x)
+static void reg_read_magic(dev_handle_t* dev, uint32_t* x)
 {
-  reg_read(epci, REG_MAGIC, x);
+  reg_read(dev, REG_MAGIC, x);
 }
 
-static void reg_write_ctl(epcihandle_t epci, uint32_t x)
+static void reg_write_ctl(dev_handle_t* dev, uint32_t x)
 {
-  reg_write(epci, REG_CTL, x);
+  reg_write(dev, REG_CTL, x);
 }
 
-static void reg_read_fclk(epcihandle_t epci, uint32_t* x)
+static void reg_read_fclk(dev_handle_t* dev, uint32_t* x)
 {
-  reg_read(epci, REG_FCLK, x);
+  reg_read(dev, REG_FCLK, x);
 }
 
-static void reg_read_start(epcihandle_t epci, uint32_t* x)
+static void reg_read_start(dev_handle_t* dev, uint32_t* x)
 {
-  reg_read(epci, REG_START, x);
+  reg_read(dev, REG_START, x);
 }
 
-static void reg_read_now(epcihandle_t epci, uint32_t* x)
+static void reg_read_now(dev_handle_t* dev, uint32_t* x)
 {
-  reg_read(epci, REG_NOW, x);
+  reg_read(dev, REG_NOW, x);
 }
 
-__attribute__((unused))
-static void reg_read_count(epcihandle_t epci, uint32_t* x)
+static void reg_read_count(dev_handle_t* dev, uint32_t* x)
 {
-  reg_read(epci, REG_COUNT, x);
+  reg_read(dev, REG_COUNT, x);
 }
 
 
@@ -209,7 +314,7 @@ typedef struct rtask_arg
 #define LAT_MAX_US 1000000
 #define LAT_RES_US 1
 #define LAT_MAX_COUNT (LAT_MAX_US / LAT_RES_US)
-  uint32_t* lat_hist;
+  hist_t lat_hist;
 
   /* number of handled IRQs */
   size_t irq_count;
@@ -217,8 +322,44 @@ typedef struct rtask_arg
   /* number of missed irqs */
   size_t irq_missed;
 
+  /* per sample trace, or NULL */
+  trace_writer_t* trace;
+
+  /* dTLB load and store misses of the realtime loop, -1 if unknown */
+  uint64_t dtlb_misses[2];
+  unsigned int is_dtlb_kernel;
+
+  /* events of the other fds of the event loop */
+  size_t wait_others;
+
+  /* cpu time of the realtime task and of the process during the */
+  /* loop, and the loop duration, in seconds */
+  double cpu_thread;
+  double cpu_process;
+  double cpu_wall;
+
+  /* wakes with at least one new IRQ, the IRQs generated between */
+  /* them, and the most IRQs at a wake */
+  size_t wakes;
+  size_t irq_serviced;
+  size_t wake_max;
+
+  /* CLOCK_MONOTONIC time of the IRQ generation start, in seconds. */
+  /* IRQ <count> is generated about <count> / fgen later, so that */
+  /* trace outliers can be aligned with other logs, ie. load -chaos */
+  double mono_start;
+
+  /* epoll feeder, see rtask_handle_t */
+  const evloop_feeder_t* feeder;
+
 } rtask_arg_t;
 
+/* trace ring records */
+#define TRACE_RING_SIZE (1 << 16)
+
+/* most IRQs serviced at a wake, more is a counter resync */
+#define BATCH_MAX_IRQS 4096
+
 /* sigint catcher */
 
 static volatile unsigned int is_sigint;
@@ -228,108 +369,88 @@ static void on_sigint(int x)
   is_sigint = 1;
 }
 
-static int enable_ebone_slave_interrupt(void)
+static uint64_t get_ms(void)
 {
-  /* ebm0 documentation: ebm0_pcie_a.pdf */
-
-  epcihandle_t bar0_handle;
-  uint32_t x;
-
-  bar0_handle = epci_open("10ee:eb01", NULL, 0);
-  if (bar0_handle == EPCI_BAD_HANDLE) return -1;
-
-  /* control register 0 */
-  /* ebone slave interrupt enable (bit 9) */
-  /* global interrupt enable (bit 31) */
-  epci_rd32_reg(bar0_handle, 0x0, &x);
-  x |= (1 << 31) | (1 << 9);
-  epci_wr32_reg(bar0_handle, 0x0, x);
-
-  /* which slave triggers an interrupt can be known */
-  /* using status register 1 (offset 0x14) */
-
-  epci_close(bar0_handle);
-
-  return 0;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
 }
 
-/* debugging probe setup */
-
-__attribute__((unused)) static void setup_probe(void)
+static double get_cpu(const struct rusage* ru)
 {
-  /* const uint32_t value = (10 << 15) | (9 << 10) | (8 << 5) | (12 << 0); */
-  static const uint32_t value = (19 << 15) | (21 << 10) | (20 << 5) | (17 << 0);
-  static char* const device_id = "10ee:eb01";
-  epcihandle_t bar;
-  bar = epci_open(device_id, NULL, 0);
-  epci_wr32_reg(bar, 0x0004, value);
-  epci_close(bar);
+  /* user and system time, in seconds */
+  return
+    (double)(ru->ru_utime.tv_sec + ru->ru_stime.tv_sec) +
+    (double)(ru->ru_utime.tv_usec + ru->ru_stime.tv_usec) / 1000000.0;
 }
 
 static int rtask_main(void* p)
 {
   rtask_arg_t* const arg = (rtask_arg_t*)p;
   cmdline_t* const cmd = arg->cmd;
-  uirq_handle_t uirq;
-  epcihandle_t epci;
+  dev_handle_t dev;
+  waiter_t waiter;
+  struct rusage ru[2][2];
+  struct timespec ts;
+  uint64_t wall;
   uint32_t mask;
   uint32_t irq_fclk;
   uint32_t x;
   uint32_t xx;
   uint32_t xxx;
+  uint32_t count;
+  uint32_t fdiv;
+  uint32_t last_count;
+  uint32_t n;
+  uint64_t ticks;
+  trace_rec_t rec;
+  perf_counter_t dtlb[2];
+  unsigned int is_dtlb[2];
+  size_t i;
   int err = -1;
 
-  /* initialize uirq */
-
-  if (enable_ebone_slave_interrupt())
-  {
-    PERROR();
-    goto on_error_0;
-  }
+  is_sigint = 0;
+  signal(SIGINT, on_sigint);
 
-  if (uirq_init_lib())
-  {
-    PERROR();
-    goto on_error_0;
-  }
+  /* the dtlb counters are read after the loop only: an error before */
+  /* it reports them unavailable */
 
-  if (uirq_open(&uirq))
-  {
-    PERROR();
-    goto on_error_1;
-  }
+  arg->dtlb_misses[0] = (uint64_t)-1;
+  arg->dtlb_misses[1] = (uint64_t)-1;
+  arg->is_dtlb_kernel = 0;
 
-  if (uirq_set_mask(&uirq, 1 << 1, 1))
-  {
-    PERROR();
-    goto on_error_2;
-  }
+  arg->wait_others = 0;
+  arg->cpu_thread = 0;
+  arg->cpu_process = 0;
+  arg->cpu_wall = 0;
+  arg->wakes = 0;
+  arg->irq_serviced = 0;
+  arg->wake_max = 0;
+  arg->mono_start = 0;
 
-  is_sigint = 0;
-  signal(SIGINT, on_sigint);
+  /* open the event source */
 
-  epci = epci_open("10ee:eb01", NULL, REG_BAR);
-  if (epci == EPCI_BAD_HANDLE)
+  if (dev_open(&dev, cmd->dev_spec))
   {
     PERROR();
-    goto on_error_2;
+    goto on_error_0;
   }
 
   /* disable to reset counters */
 
-  reg_write_ctl(epci, 0);
+  reg_write_ctl(&dev, 0);
 
   /* check magic */
 
-  reg_read_magic(epci, &x);
-  if (x != 0xbadcafee)
+  reg_read_magic(&dev, &x);
+  if (x != REG_MAGIC_VALUE)
   {
     PERROR();
     goto on_error_3;
   }
 
 #if 0 /* test irq generation */
-  setup_probe();
+  /* setup_probe(), see dev_hw.c */
 
   /* while (is_sigint == 0) { usleep(100000); } */
   /* goto on_error_3; */
@@ -339,13 +460,13 @@ static int rtask_main(void* p)
   {
     uint32_t togl_count;
 
-    reg_write_ctl(epci, x);
+    reg_write_ctl(&dev, x);
     x ^= 1 << 30;
 
-    reg_read_togl(epci, &togl_count);
+    reg_read_togl(&dev, &togl_count);
     printf("0x%08x\n", togl_count);
 
-    if (uirq_wait(&uirq, 1000, &mask) == 0) printf("mask: 0x%08x\n", mask);
+    if (dev_wait(&dev, 1000, &mask) == 0) printf("mask: 0x%08x\n", mask);
 
     usleep(1000000);
   }
@@ -355,7 +476,8 @@ static int rtask_main(void* p)
   /* irq_fdiv * 1 / irq_fclk = 1 / irq_fgen */
   /* irq_fdiv = irq_fclk / irq_fgen */
 
-  reg_read_fclk(epci, &irq_fclk);
+  reg_read_fclk(&dev, &irq_fclk);
+  if (arg->trace != NULL) arg->trace->header.fclk = irq_fclk;
   x = irq_fclk / cmd->irq_fgen;
   if (x == 0)
   {
@@ -363,27 +485,115 @@ static int rtask_main(void* p)
     goto on_error_3;
   }
 
-  reg_write_ctl(epci, (1 << 31) | x);
+  if (waiter_open
+      (&waiter, &dev, cmd->wait_mode, cmd->wait_cpu, arg->feeder))
+  {
+    PERROR();
+    goto on_error_3;
+  }
+
+  fdiv = x;
+  reg_write_ctl(&dev, (1 << 31) | x);
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  arg->mono_start = (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+
+  /* dTLB misses of the loop only, where the PMU supports them */
+
+  is_dtlb[0] =
+    (perf_open(&dtlb[0], PERF_TYPE_HW_CACHE, PERF_DTLB_LOAD_MISSES) == 0);
+  is_dtlb[1] =
+    (perf_open(&dtlb[1], PERF_TYPE_HW_CACHE, PERF_DTLB_STORE_MISSES) == 0);
+
+  /* cpu cost of the wait mode */
 
+  getrusage(RUSAGE_THREAD, &ru[0][0]);
+  getrusage(RUSAGE_SELF, &ru[0][1]);
+  wall = get_ms();
+
+  last_count = 0;
   arg->irq_missed = 0;
   for (arg->irq_count = 0; 1; ++arg->irq_count)
   {
-    err = uirq_wait(&uirq, 1000, &mask);
+    err = waiter_wait(&waiter, 1000, &mask);
     if (err == -1)
     {
-      PERROR();
-      goto on_error_3;
+      PERROR_ARGS("errno=%llu", (unsigned long long)errno, 0);
+      goto on_error_5;
     }
 
+    /* end of an offline source */
+
+    if (err == 1) break ;
+
     err = 0;
 
-    if (mask == 0) goto skip_irq;
+    if (mask == 0)
+    {
+      if (arg->trace != NULL)
+      {
+        rec.start = 0;
+        rec.now = 0;
+        rec.count = 0;
+        rec.mask = 0;
+        trace_writer_push(arg->trace, &rec);
+      }
+      goto skip_irq;
+    }
 
     /* compute latency (ie. now - start) */
     /* beware the underflow */
 
-    reg_read_start(epci, &x);
-    reg_read_now(epci, &xx);
+    reg_read_start(&dev, &x);
+    reg_read_now(&dev, &xx);
+    reg_read_count(&dev, &count);
+
+    if (arg->trace != NULL)
+    {
+      rec.start = x;
+      rec.now = xx;
+      rec.count = count;
+      rec.mask = mask;
+      trace_writer_push(arg->trace, &rec);
+    }
+
+    /* the IRQs since the last wake are the count minus the last */
+    /* serviced count. timeouts leave the latter unchanged. a jump */
+    /* above BATCH_MAX_IRQS (or a counter going backwards) is a resync: */
+    /* it is not serviced, and counted as misses in batch mode */
+
+    n = count - last_count;
+    last_count = count;
+
+    if (n > BATCH_MAX_IRQS)
+    {
+      if (cmd->is_batch) arg->irq_missed += (n < 0x80000000) ? n : 1;
+      n = 0;
+    }
+
+    if (n != 0)
+    {
+      ++arg->wakes;
+      arg->irq_serviced += n;
+      if (n > arg->wake_max) arg->wake_max = n;
+    }
+
+    /* batch service: REG_START is the start of the last IRQ, the kth */
+    /* before it started k periods earlier */
+
+    if (cmd->is_batch)
+    {
+      for (; n; --n)
+      {
+	ticks = (uint64_t)(uint32_t)(xx - x) + (uint64_t)(n - 1) * fdiv;
+	ticks = (ticks * (uint64_t)1000000) / (uint64_t)irq_fclk;
+	if (ticks >= LAT_MAX_COUNT) ++arg->irq_missed;
+	else hist_record(&arg->lat_hist, (uint32_t)ticks);
+      }
+
+      arg->irq_count = (size_t)count - 1;
+      goto skip_irq;
+    }
+
     if (xx < x) xxx = ((uint32_t)-1) - x + xx;
     else xxx = xx - x;
 
@@ -401,17 +611,16 @@ static int rtask_main(void* p)
 
     /* check for missed IRQ before actually updating histogram */
 
-    reg_read_count(epci, &x);
-    if (arg->irq_count != ((size_t)x - 1))
+    if (arg->irq_count != ((size_t)count - 1))
     {
       ++arg->irq_missed;
-      arg->irq_count = (size_t)x - 1;
+      arg->irq_count = (size_t)count - 1;
       goto skip_irq;
     }
 
     /* update histogram */
 
-    ++arg->lat_hist[xxx];
+    hist_record(&arg->lat_hist, xxx);
 
   skip_irq:
     if (is_sigint) break ;
@@ -420,57 +629,273 @@ static int rtask_main(void* p)
 
   err = 0;
 
+ on_error_5:
+  getrusage(RUSAGE_THREAD, &ru[1][0]);
+  getrusage(RUSAGE_SELF, &ru[1][1]);
+  arg->cpu_wall = (double)(get_ms() - wall) / 1000.0;
+  arg->cpu_thread = get_cpu(&ru[1][0]) - get_cpu(&ru[0][0]);
+  arg->cpu_process = get_cpu(&ru[1][1]) - get_cpu(&ru[0][1]);
+
+  arg->is_dtlb_kernel = is_dtlb[0] | is_dtlb[1];
+  for (i = 0; i != 2; ++i)
+  {
+    if (is_dtlb[i] == 0) continue ;
+    if (perf_read(&dtlb[i], &arg->dtlb_misses[i]))
+      arg->dtlb_misses[i] = (uint64_t)-1;
+    arg->is_dtlb_kernel &= dtlb[i].is_kernel;
+    perf_close(&dtlb[i]);
+  }
+  if (cmd->wait_mode == WAIT_EPOLL) arg->wait_others = waiter.loop.nothers;
+  waiter_close(&waiter);
  on_error_3:
-  reg_write_ctl(epci, 0);
-  epci_close(epci);
- on_error_2:
-  uirq_close(&uirq);
- on_error_1:
-  /* uirq_fini_lib(); */
+  reg_write_ctl(&dev, 0);
+  dev_close(&dev);
  on_error_0:
   return err;
 }
 
 
+/* report */
+
+static void print_report(const rtask_arg_t* arg)
+{
+  static const double p[] = { 0, 50, 90, 99, 99.9, 99.99, 100 };
+  static const char* const s[] =
+    { "min", "p50", "p90", "p99", "p99.9", "p99.99", "max" };
+  uint32_t x[sizeof(p) / sizeof(p[0])];
+  double mean;
+  double stddev;
+  size_t i;
+
+  /* pending diagnostics first */
+  rtlog_flush();
+
+  printf("# irq_count : %zu\n", arg->irq_count);
+  printf("# irq_missed: %zu\n", arg->irq_missed);
+  if (arg->trace != NULL)
+    printf("# trace_dropped: %zu\n", arg->trace->dropped);
+  if (rtlog_dropped())
+    printf("# rtlog_dropped: %zu\n", rtlog_dropped());
+
+  printf("# wait: mode=%s other_events=%zu\n",
+	 waiter_mode_name(arg->cmd->wait_mode), arg->wait_others);
+  printf("# cpu: thread=%.3f process=%.3f wall=%.3f\n",
+	 arg->cpu_thread, arg->cpu_process, arg->cpu_wall);
+  printf("# clock: mono_start=%.6f\n", arg->mono_start);
+
+  /* per second of source time, irq_serviced periods, which is also */
+  /* valid for the offline sources */
+
+  if (arg->wakes)
+  {
+    printf("# batch: mode=%u wakes=%zu irqs_per_wake=%.3f max=%zu"
+	   " wakes_per_s=%.1f\n",
+	   arg->cmd->is_batch, arg->wakes,
+	   (double)arg->irq_serviced / (double)arg->wakes,
+	   arg->wake_max,
+	   ((double)arg->wakes * (double)arg->cmd->irq_fgen) /
+	   (double)arg->irq_serviced);
+  }
+
+  printf("# dtlb_misses: load=%lld store=%lld domain=%s\n",
+	 (long long)arg->dtlb_misses[0], (long long)arg->dtlb_misses[1],
+	 arg->is_dtlb_kernel ? "all" : "user");
+
+  if (hist_moments(&arg->lat_hist, &mean, &stddev) == 0)
+  {
+    printf("# lat_mean  : %.3f\n", mean);
+    printf("# lat_stddev: %.3f\n", stddev);
+  }
+
+  if (hist_percentiles(&arg->lat_hist, p, x, sizeof(p) / sizeof(p[0])) == 0)
+  {
+    for (i = 0; i != sizeof(p) / sizeof(p[0]); ++i)
+      printf("# lat_%-7s: %u\n", s[i], x[i]);
+  }
+
+  hist_print(&arg->lat_hist, stdout);
+}
+
+
 /* main */
 
 int main(int ac, char** av)
 {
-  size_t i;
   cmdline_t cmd;
   rtask_handle_t rtask;
-  rtask_arg_t arg;
+  rtask_arg_t* arg;
+  trace_writer_t* trace;
+  trace_header_t header;
+  trace_writer_t* trace_inside;
+  isolate_t iso;
+  evloop_feeder_t feeder;
+  bench_arg_t bench;
+  char irq_cpus[256];
+  rtmem_t rt_mem;
+  size_t ring_off;
+  size_t bins_off;
+  size_t size;
+  int policy;
   int err = -1;
 
+  /* diagnostics are written by a non realtime thread */
+
+  if (rtlog_open(stdout)) return -1;
+
   if (get_cmdline(&cmd, (size_t)ac - 1, av + 1)) goto on_error_0;
-  arg.cmd = &cmd;
 
-  /* allocate latency history */
+  /* realtime memory: the task state, the trace writer and ring, and */
+  /* the latency histogram share one region on the realtime task node, */
+  /* so that huge pages cover them all */
+
+  ring_off = (sizeof(rtask_arg_t) + sizeof(trace_writer_t) + 63) & ~(size_t)63;
+  bins_off = ring_off;
+  if (cmd.trace_path != NULL) bins_off += TRACE_RING_SIZE * sizeof(trace_rec_t);
+  size = bins_off + LAT_MAX_COUNT * sizeof(uint64_t);
+
+  if (rtmem_alloc(&rt_mem, size, cmd.mem_node, cmd.is_hugepages))
+    goto on_error_0;
+  printf("# rtmem: page=%s size=%zu\n",
+	 rtmem_page_name(rt_mem.page), rt_mem.size);
+
+  arg = (rtask_arg_t*)rt_mem.addr;
+  trace = (trace_writer_t*)(arg + 1);
+  arg->cmd = &cmd;
+  hist_init_with(&arg->lat_hist, (uint64_t*)((uint8_t*)rt_mem.addr + bins_off),
+		 LAT_MAX_COUNT, LAT_RES_US);
+
+  arg->irq_count = 0;
+
+  /* the epoll feeder runs around each run of the realtime task */
 
-  arg.lat_hist = malloc(LAT_MAX_COUNT * sizeof(uint32_t));
-  if (arg.lat_hist == NULL) goto on_error_1;
-  for (i = 0; i != LAT_MAX_COUNT; ++i) arg.lat_hist[i] = 0;
+  rtask.feeder = (cmd.wait_mode == WAIT_EPOLL) ? &feeder : NULL;
+  arg->feeder = rtask.feeder;
 
-  arg.irq_count = 0;
+  /* open trace, fclk is set by the realtime task */
+
+  arg->trace = NULL;
+  if (cmd.trace_path != NULL)
+  {
+    header.magic = TRACE_MAGIC;
+    header.version = TRACE_VERSION;
+    header.fclk = 0;
+    header.fgen = cmd.irq_fgen;
+    if (trace_writer_open_with
+	(trace, cmd.trace_path, &header, TRACE_RING_SIZE,
+	 (trace_rec_t*)((uint8_t*)rt_mem.addr + ring_off)))
+      goto on_error_1;
+    arg->trace = trace;
+  }
 
   /* start wait realtime task */
 
-  if (rtask_start(&rtask, rtask_main, (void*)&arg)) goto on_error_1;
+  policy = SCHED_FIFO;
+  if (dev_find(cmd.dev_spec)->is_offline)
+  {
+    policy = SCHED_OTHER;
+    if (arg->trace != NULL) arg->trace->is_blocking = 1;
+  }
+
+  /* the trace covers the run inside the partition, if any */
+
+  trace_inside = arg->trace;
+
+  /* device IRQ placement, restored at exit */
+
+  if (cmd.irq_cpus != NULL)
+  {
+    if (irq_get_cpus(cmd.irq, irq_cpus, sizeof(irq_cpus)) ||
+	irq_set_cpus(cmd.irq, cmd.irq_cpus))
+    {
+      PERROR();
+      goto on_error_2;
+    }
+  }
+
+  printf("# placement: cpu=%d irq_cpu=%s cpu_node=%d mem_node=%d\n",
+	 cmd.cpu, (cmd.irq_cpus != NULL) ? cmd.irq_cpus : "-",
+	 (cmd.cpu >= 0) ? numa_cpu_node(cmd.cpu) : -1, cmd.mem_node);
+
+  /* self benchmark, with the same policy and placement */
+
+  if (cmd.is_bench)
+  {
+    bench.dev_spec = cmd.dev_spec;
+    bench.wait_mode = cmd.wait_mode;
+    bench.wait_cpu = cmd.wait_cpu;
+    bench.feeder = rtask.feeder;
+    bench.lat_count = LAT_MAX_COUNT;
+    bench.lat_res = LAT_RES_US;
+    bench.count = cmd.irq_count ? cmd.irq_count : BENCH_DEFAULT_COUNT;
+    if (rtask_start(&rtask, bench_main, (void*)&bench, policy,
+		    cmd.cpu, cmd.mem_node, NULL))
+      goto on_error_3;
+    err = rtask_wait(&rtask);
+    goto on_error_3;
+  }
+
+  /* outside the partition, a first run without trace */
+
+  if (cmd.isolate_cpus != NULL)
+  {
+    arg->trace = NULL;
+    if (rtask_start(&rtask, rtask_main, (void*)arg, policy,
+		    cmd.cpu, cmd.mem_node, NULL))
+      goto on_error_3;
+    err = rtask_wait(&rtask);
+
+    printf("# partition: outside\n");
+    print_report(arg);
+
+    if (err || is_sigint) goto on_error_3;
+
+    /* gnuplot data set separator */
+    printf("\n\n");
+
+    hist_clear(&arg->lat_hist);
+    arg->irq_count = 0;
+    arg->trace = trace_inside;
+    err = -1;
+
+    if (isolate_open(&iso, cmd.isolate_cpus, cmd.irq))
+    {
+      PERROR();
+      goto on_error_3;
+    }
+
+    if (isolate_enter(&iso))
+    {
+      PERROR();
+      isolate_close(&iso);
+      goto on_error_3;
+    }
+  }
+
+  if (rtask_start(&rtask, rtask_main, (void*)arg, policy, cmd.cpu, cmd.mem_node,
+		  (cmd.isolate_cpus != NULL) ? &iso : NULL))
+    goto on_error_4;
   err = rtask_wait(&rtask);
-  /* if (err) goto on_error_1; */
+  /* if (err) goto on_error_4; */
 
   /* report latencies */
-  printf("# irq_count : %zu\n", arg.irq_count);
-  printf("# irq_missed: %zu\n", arg.irq_missed);
+  if (cmd.isolate_cpus != NULL)
+    printf("# partition: inside %s\n", cmd.isolate_cpus);
+  print_report(arg);
 
-  for (i = 0; i != LAT_MAX_COUNT; ++i)
+ on_error_4:
+  if (cmd.isolate_cpus != NULL)
   {
-    if (arg.lat_hist[i] == 0) continue ;
-    printf("%zu %u\n", i * LAT_RES_US, arg.lat_hist[i]);
+    isolate_leave(&iso);
+    isolate_close(&iso);
   }
-  
+ on_error_3:
+  if (cmd.irq_cpus != NULL) irq_set_cpus(cmd.irq, irq_cpus);
+ on_error_2:
+  if (trace_inside != NULL) trace_writer_close(trace_inside);
  on_error_1:
-  free(arg.lat_hist);
+  hist_fini(&arg->lat_hist);
+  rtmem_free(&rt_mem);
  on_error_0:
+  rtlog_close();
   return err;
 }
@@ -0,0 +1,45 @@
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf.h"
+
+
+static int open_event(uint32_t type, uint64_t config, unsigned int is_kernel)
+{
+  struct perf_event_attr attr;
+
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.exclude_kernel = is_kernel ? 0 : 1;
+  attr.exclude_hv = 1;
+
+  /* calling thread, any cpu */
+  return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int perf_open(perf_counter_t* c, uint32_t type, uint64_t config)
+{
+  c->is_kernel = 1;
+  c->fd = open_event(type, config, 1);
+  if (c->fd != -1) return 0;
+
+  c->is_kernel = 0;
+  c->fd = open_event(type, config, 0);
+  if (c->fd != -1) return 0;
+
+  return -1;
+}
+
+int perf_read(const perf_counter_t* c, uint64_t* x)
+{
+  if (read(c->fd, x, sizeof(uint64_t)) != (ssize_t)sizeof(uint64_t)) return -1;
+  return 0;
+}
+
+void perf_close(perf_counter_t* c)
+{
+  close(c->fd);
+}
@@ -0,0 +1,35 @@
+#ifndef PERF_H_INCLUDED
+#define PERF_H_INCLUDED
+
+
+/* hardware event counters of the calling thread, using perf_event_open */
+/* directly. kernel events are counted when perf_event_paranoid allows */
+/* it, else only user ones. */
+
+
+#include <stdint.h>
+#include <linux/perf_event.h>
+
+
+/* dTLB load and store misses */
+#define PERF_DTLB_LOAD_MISSES \
+  (PERF_COUNT_HW_CACHE_DTLB | \
+   (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+#define PERF_DTLB_STORE_MISSES \
+  (PERF_COUNT_HW_CACHE_DTLB | \
+   (PERF_COUNT_HW_CACHE_OP_WRITE << 8) | \
+   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+typedef struct perf_counter
+{
+  int fd;
+  unsigned int is_kernel;
+} perf_counter_t;
+
+int perf_open(perf_counter_t*, uint32_t, uint64_t);
+int perf_read(const perf_counter_t*, uint64_t*);
+void perf_close(perf_counter_t*);
+
+
+#endif /* PERF_H_INCLUDED */
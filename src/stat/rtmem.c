@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "numa.h"
+#include "debug.h"
+#include "rtmem.h"
+
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0x40000
+#endif
+
+#define DEFAULT_HPAGE_SIZE (2 * 1024 * 1024)
+
+static size_t get_hpage_size(void)
+{
+  /* the default huge page size, used by MAP_HUGETLB */
+
+  char line[128];
+  unsigned long kb;
+  size_t size = DEFAULT_HPAGE_SIZE;
+  FILE* file;
+
+  file = fopen("/proc/meminfo", "r");
+  if (file == NULL) return size;
+
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    if (sscanf(line, "Hugepagesize: %lu kB", &kb) != 1) continue ;
+    size = (size_t)kb * 1024;
+    break ;
+  }
+
+  fclose(file);
+
+  return size;
+}
+
+static int map_small(rtmem_t* mem, size_t size)
+{
+  mem->map_size = size;
+  mem->map_addr = mmap(NULL, size, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem->map_addr == MAP_FAILED) return -1;
+  mem->addr = mem->map_addr;
+  mem->page = RTMEM_PAGE_SMALL;
+  return 0;
+}
+
+static int map_huge(rtmem_t* mem, size_t size)
+{
+  const size_t hsize = get_hpage_size();
+  const size_t rsize = ((size + hsize - 1) / hsize) * hsize;
+
+  /* the region is rounded up to whole huge pages */
+
+  mem->size = rsize;
+
+  /* explicit huge pages, if the pool has enough */
+
+  mem->map_size = rsize;
+  mem->map_addr = mmap(NULL, rsize, PROT_READ | PROT_WRITE,
+		       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (mem->map_addr != MAP_FAILED)
+  {
+    mem->addr = mem->map_addr;
+    mem->page = RTMEM_PAGE_HUGETLB;
+    return 0;
+  }
+
+  /* transparent huge pages, the region is over allocated to be aligned */
+
+  if (map_small(mem, rsize + hsize)) return -1;
+  mem->addr = (void*)
+    (((uintptr_t)mem->map_addr + hsize - 1) & ~(uintptr_t)(hsize - 1));
+  if (madvise(mem->addr, rsize, MADV_HUGEPAGE)) return 0;
+  mem->page = RTMEM_PAGE_THP;
+
+  return 0;
+}
+
+int rtmem_alloc(rtmem_t* mem, size_t size, int node, unsigned int is_huge)
+{
+  mem->size = size;
+  mem->node = node;
+
+  if (is_huge)
+  {
+    if (map_huge(mem, size)) goto on_error_0;
+  }
+  else
+  {
+    if (map_small(mem, size)) goto on_error_0;
+  }
+
+  /* bind before the pages are faulted in */
+
+  if ((node >= 0) && numa_bind_range(mem->addr, mem->size, node))
+  {
+    PERROR();
+    goto on_error_1;
+  }
+
+  memset(mem->addr, 0, mem->size);
+
+  /* unprivileged offline runs may not lock, this is not an error */
+
+  mlock(mem->addr, mem->size);
+
+  return 0;
+
+ on_error_1:
+  munmap(mem->map_addr, mem->map_size);
+ on_error_0:
+  return -1;
+}
+
+void rtmem_free(rtmem_t* mem)
+{
+  munlock(mem->addr, mem->size);
+  munmap(mem->map_addr, mem->map_size);
+}
+
+const char* rtmem_page_name(unsigned int page)
+{
+  static const char* const names[] = { "small", "thp", "hugetlb" };
+  return (page < (sizeof(names) / sizeof(names[0]))) ? names[page] : "unknown";
+}
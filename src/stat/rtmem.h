@@ -0,0 +1,39 @@
+#ifndef RTMEM_H_INCLUDED
+#define RTMEM_H_INCLUDED
+
+
+/* memory of the realtime path: mapped, bound to a numa node, faulted */
+/* in and locked before the run, so that the realtime task neither */
+/* takes page faults nor touches remote memory. with huge pages, the */
+/* whole region needs a few TLB entries: explicit huge pages are tried */
+/* first (MAP_HUGETLB, from the vm.nr_hugepages pool), then transparent */
+/* huge pages on an aligned region. */
+
+
+#include <stddef.h>
+
+
+#define RTMEM_PAGE_SMALL 0
+#define RTMEM_PAGE_THP 1
+#define RTMEM_PAGE_HUGETLB 2
+
+typedef struct rtmem
+{
+  void* addr;
+  /* at least the requested size, rounded up to huge pages if any */
+  size_t size;
+  /* numa node, or -1 if not bound */
+  int node;
+  /* RTMEM_PAGE_xxx */
+  unsigned int page;
+  /* mapping, larger than the region when aligned for THP */
+  void* map_addr;
+  size_t map_size;
+} rtmem_t;
+
+int rtmem_alloc(rtmem_t*, size_t, int, unsigned int);
+void rtmem_free(rtmem_t*);
+const char* rtmem_page_name(unsigned int);
+
+
+#endif /* RTMEM_H_INCLUDED */
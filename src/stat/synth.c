@@ -0,0 +1,51 @@
+#include <stdint.h>
+#include <math.h>
+#include "synth.h"
+
+
+/* latency model, in microseconds: a fixed wake up cost, an exponential */
+/* scheduling jitter and rare long stalls */
+
+#define SYNTH_BASE_US 5.0
+#define SYNTH_JITTER_US 10.0
+#define SYNTH_STALL_PROBA 0.0001
+#define SYNTH_STALL_MIN_US 100.0
+#define SYNTH_STALL_MAX_US 2000.0
+
+void synth_init(synth_t* synth, uint64_t seed)
+{
+  /* xorshift state must not be 0 */
+  synth->state = seed ^ 0x9e3779b97f4a7c15ULL;
+  if (synth->state == 0) synth->state = 1;
+}
+
+uint64_t synth_rand(synth_t* synth)
+{
+  /* xorshift64* */
+
+  uint64_t x = synth->state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  synth->state = x;
+  return x * 0x2545f4914f6cdd1dULL;
+}
+
+double synth_uniform(synth_t* synth)
+{
+  /* [0, 1[, 53 bits of precision */
+  return (double)(synth_rand(synth) >> 11) / 9007199254740992.0;
+}
+
+uint32_t synth_lat_ticks(synth_t* synth, uint32_t fclk)
+{
+  double us = SYNTH_BASE_US - SYNTH_JITTER_US * log(1.0 - synth_uniform(synth));
+
+  if (synth_uniform(synth) < SYNTH_STALL_PROBA)
+  {
+    us += SYNTH_STALL_MIN_US +
+      (SYNTH_STALL_MAX_US - SYNTH_STALL_MIN_US) * synth_uniform(synth);
+  }
+
+  return (uint32_t)(us * (double)fclk / 1000000.0);
+}
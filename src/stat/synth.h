@@ -0,0 +1,23 @@
+#ifndef SYNTH_H_INCLUDED
+#define SYNTH_H_INCLUDED
+
+
+/* seeded pseudo random generator and latency model, so that synthetic */
+/* runs are reproducible from their seed */
+
+
+#include <stdint.h>
+
+
+typedef struct synth
+{
+  uint64_t state;
+} synth_t;
+
+void synth_init(synth_t*, uint64_t);
+uint64_t synth_rand(synth_t*);
+double synth_uniform(synth_t*);
+uint32_t synth_lat_ticks(synth_t*, uint32_t);
+
+
+#endif /* SYNTH_H_INCLUDED */
@@ -0,0 +1,246 @@
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "debug.h"
+#include "dev.h"
+#include "uring.h"
+
+
+#if (CONFIG_URING == 1)
+
+
+#define URING_ENTRIES 4
+
+/* SQPOLL thread idle time before it sleeps, in ms */
+#define URING_SQ_IDLE_MS 1000
+
+/* cqe user_data */
+#define URING_ID_POLL 1
+#define URING_ID_TIMEOUT 2
+
+static int sys_setup(unsigned int n, struct io_uring_params* p)
+{
+  return (int)syscall(__NR_io_uring_setup, n, p);
+}
+
+static int sys_enter
+(int fd, unsigned int n, unsigned int min, unsigned int flags)
+{
+  return (int)syscall(__NR_io_uring_enter, fd, n, min, flags, NULL, 0);
+}
+
+int uring_open
+(uring_t* u, dev_handle_t* dev, unsigned int is_sqpoll, int sq_cpu)
+{
+  struct io_uring_params p;
+  uint8_t* sq;
+  uint8_t* cq;
+
+  u->dev = dev;
+  u->is_sqpoll = is_sqpoll;
+
+  if (dev_fd(dev) == -1)
+  {
+    PERROR();
+    goto on_error_0;
+  }
+
+  memset(&p, 0, sizeof(p));
+  if (is_sqpoll)
+  {
+    p.flags = IORING_SETUP_SQPOLL;
+    p.sq_thread_idle = URING_SQ_IDLE_MS;
+
+    /* the SQPOLL thread must not share the cpu of a realtime task, */
+    /* it would only run once the task sleeps */
+    if (sq_cpu >= 0)
+    {
+      p.flags |= IORING_SETUP_SQ_AFF;
+      p.sq_thread_cpu = (uint32_t)sq_cpu;
+    }
+  }
+
+  u->fd = sys_setup(URING_ENTRIES, &p);
+  if (u->fd == -1)
+  {
+    PERROR_ARGS("errno=%llu", (unsigned long long)errno, 0);
+    goto on_error_0;
+  }
+
+  /* rings */
+
+  u->sq_map_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+  u->cq_map_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+  if (p.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    if (u->cq_map_size > u->sq_map_size) u->sq_map_size = u->cq_map_size;
+    u->cq_map_size = u->sq_map_size;
+  }
+
+  u->sq_map = mmap(NULL, u->sq_map_size, PROT_READ | PROT_WRITE,
+		   MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+  if (u->sq_map == MAP_FAILED) goto on_error_1;
+
+  u->cq_map = u->sq_map;
+  if ((p.features & IORING_FEAT_SINGLE_MMAP) == 0)
+  {
+    u->cq_map = mmap(NULL, u->cq_map_size, PROT_READ | PROT_WRITE,
+		     MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+    if (u->cq_map == MAP_FAILED) goto on_error_2;
+  }
+
+  u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  u->sqes = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+		 MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+  if (u->sqes == MAP_FAILED) goto on_error_3;
+
+  sq = (uint8_t*)u->sq_map;
+  u->sq_head = (uint32_t*)(sq + p.sq_off.head);
+  u->sq_tail = (uint32_t*)(sq + p.sq_off.tail);
+  u->sq_flags = (uint32_t*)(sq + p.sq_off.flags);
+  u->sq_array = (uint32_t*)(sq + p.sq_off.array);
+  u->sq_mask = *(uint32_t*)(sq + p.sq_off.ring_mask);
+
+  cq = (uint8_t*)u->cq_map;
+  u->cq_head = (uint32_t*)(cq + p.cq_off.head);
+  u->cq_tail = (uint32_t*)(cq + p.cq_off.tail);
+  u->cq_mask = *(uint32_t*)(cq + p.cq_off.ring_mask);
+  u->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+
+  return 0;
+
+ on_error_3:
+  if (u->cq_map != u->sq_map) munmap(u->cq_map, u->cq_map_size);
+ on_error_2:
+  munmap(u->sq_map, u->sq_map_size);
+ on_error_1:
+  close(u->fd);
+ on_error_0:
+  return -1;
+}
+
+void uring_close(uring_t* u)
+{
+  munmap(u->sqes, u->sqes_size);
+  if (u->cq_map != u->sq_map) munmap(u->cq_map, u->cq_map_size);
+  munmap(u->sq_map, u->sq_map_size);
+  close(u->fd);
+}
+
+static int submit(uring_t* u, unsigned int ms)
+{
+  const uint32_t tail = *u->sq_tail;
+  struct io_uring_sqe* sqe;
+  uint32_t i;
+
+  u->ts.tv_sec = ms / 1000;
+  u->ts.tv_nsec = (long long)(ms % 1000) * 1000000;
+
+  /* poll of the IRQ fd */
+
+  i = tail & u->sq_mask;
+  sqe = &u->sqes[i];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_POLL_ADD;
+  sqe->fd = dev_fd(u->dev);
+  sqe->poll32_events = POLLIN;
+  sqe->flags = IOSQE_IO_LINK;
+  sqe->user_data = URING_ID_POLL;
+  u->sq_array[i] = i;
+
+  /* cancels the poll when expiring */
+
+  i = (tail + 1) & u->sq_mask;
+  sqe = &u->sqes[i];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_LINK_TIMEOUT;
+  sqe->fd = -1;
+  sqe->addr = (uint64_t)(uintptr_t)&u->ts;
+  sqe->len = 1;
+  sqe->user_data = URING_ID_TIMEOUT;
+  u->sq_array[i] = i;
+
+  __atomic_store_n(u->sq_tail, tail + 2, __ATOMIC_RELEASE);
+
+  if (u->is_sqpoll == 0) return (sys_enter(u->fd, 2, 0, 0) == 2) ? 0 : -1;
+
+  /* the SQPOLL thread sleeps once idle, the flag is read after the tail */
+  /* is published */
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(u->sq_flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP)
+  {
+    if (sys_enter(u->fd, 0, 0, IORING_ENTER_SQ_WAKEUP) == -1) return -1;
+  }
+
+  return 0;
+}
+
+int uring_wait(uring_t* u, unsigned int ms, uint32_t* mask)
+{
+  /* same semantics as dev_wait. the timeout completion of a previous */
+  /* wait may still be queued, completions are matched on user_data */
+
+  struct io_uring_cqe* cqe;
+  uint32_t head;
+  uint32_t tail;
+  int res;
+
+  if (dev_arm(u->dev)) return -1;
+  if (submit(u, ms)) return -1;
+
+  while (1)
+  {
+    head = *u->cq_head;
+    tail = __atomic_load_n(u->cq_tail, __ATOMIC_ACQUIRE);
+
+    for (; head != tail; ++head)
+    {
+      cqe = &u->cqes[head & u->cq_mask];
+      if (cqe->user_data != URING_ID_POLL) continue ;
+
+      res = cqe->res;
+      __atomic_store_n(u->cq_head, head + 1, __ATOMIC_RELEASE);
+
+      *mask = 0;
+      if (res == -ECANCELED) return 0;
+      if (res < 0) return -1;
+      return dev_ack(u->dev, mask);
+    }
+
+    __atomic_store_n(u->cq_head, head, __ATOMIC_RELEASE);
+
+    if (sys_enter(u->fd, 0, 1, IORING_ENTER_GETEVENTS) == -1)
+    {
+      if (errno != EINTR) return -1;
+    }
+  }
+
+  return 0;
+}
+
+#else /* CONFIG_URING */
+
+int uring_open
+(uring_t* u, dev_handle_t* dev, unsigned int is_sqpoll, int sq_cpu)
+{
+  /* no io_uring in the kernel headers */
+  PERROR();
+  return -1;
+}
+
+void uring_close(uring_t* u)
+{
+}
+
+int uring_wait(uring_t* u, unsigned int ms, uint32_t* mask)
+{
+  return -1;
+}
+
+#endif /* CONFIG_URING */
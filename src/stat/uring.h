@@ -0,0 +1,83 @@
+#ifndef URING_H_INCLUDED
+#define URING_H_INCLUDED
+
+
+/* IRQ wait through io_uring, with raw system calls. each wait submits */
+/* a poll of the device IRQ fd, linked to a timeout. with SQPOLL, a */
+/* kernel thread consumes the submissions and the task only enters the */
+/* kernel to sleep until the completion. */
+
+/* the SDK kernel headers of the older targets have no io_uring, or one */
+/* without 32 bits poll events (linux 5.9). uring_open then fails, and */
+/* the other wait modes are unaffected. */
+
+
+#include <stdint.h>
+#include <stddef.h>
+#include "dev.h"
+
+#ifndef CONFIG_URING
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>) && __has_include(<linux/time_types.h>)
+#include <linux/io_uring.h>
+#include <linux/time_types.h>
+#ifdef IORING_FEAT_POLL_32BITS
+#define CONFIG_URING 1
+#endif
+#endif
+#endif
+#endif
+
+#ifndef CONFIG_URING
+#define CONFIG_URING 0
+#endif
+
+#if (CONFIG_URING == 1)
+
+typedef struct uring
+{
+  dev_handle_t* dev;
+  int fd;
+  unsigned int is_sqpoll;
+
+  /* ring mappings, sq and cq may share one */
+  void* sq_map;
+  size_t sq_map_size;
+  void* cq_map;
+  size_t cq_map_size;
+  struct io_uring_sqe* sqes;
+  size_t sqes_size;
+
+  /* submission queue */
+  uint32_t* sq_head;
+  uint32_t* sq_tail;
+  uint32_t* sq_flags;
+  uint32_t* sq_array;
+  uint32_t sq_mask;
+
+  /* completion queue */
+  uint32_t* cq_head;
+  uint32_t* cq_tail;
+  uint32_t cq_mask;
+  struct io_uring_cqe* cqes;
+
+  /* linked timeout, must live until the completion */
+  struct __kernel_timespec ts;
+} uring_t;
+
+#else
+
+typedef struct uring
+{
+  dev_handle_t* dev;
+} uring_t;
+
+#endif /* CONFIG_URING */
+
+/* SQPOLL if nonzero, with the kernel thread on a cpu if not -1 */
+int uring_open(uring_t*, dev_handle_t*, unsigned int, int);
+void uring_close(uring_t*);
+int uring_wait(uring_t*, unsigned int, uint32_t*);
+
+
+#endif /* URING_H_INCLUDED */
@@ -0,0 +1,107 @@
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include "dev.h"
+#include "evloop.h"
+#include "uring.h"
+#include "waiter.h"
+
+
+static const char* const mode_names[WAIT_COUNT] =
+{
+  "direct",
+  "epoll",
+  "uring",
+  "uring_sqpoll",
+  "busy"
+};
+
+int waiter_find_mode(const char* s, unsigned int* mode)
+{
+  for (*mode = 0; *mode != WAIT_COUNT; ++*mode)
+  {
+    if (strcmp(s, mode_names[*mode]) == 0) return 0;
+  }
+  return -1;
+}
+
+const char* waiter_mode_name(unsigned int mode)
+{
+  return (mode < WAIT_COUNT) ? mode_names[mode] : "unknown";
+}
+
+int waiter_open
+(waiter_t* w, dev_handle_t* dev, unsigned int mode, int cpu,
+ const evloop_feeder_t* feeder)
+{
+  /* feeder is the started feeder of the epoll mode, else unused */
+
+  w->mode = mode;
+  w->dev = dev;
+  w->count = 0;
+
+  switch (mode)
+  {
+  case WAIT_EPOLL: return evloop_open(&w->loop, dev, feeder);
+  case WAIT_URING: return uring_open(&w->uring, dev, 0, -1);
+  case WAIT_URING_SQPOLL: return uring_open(&w->uring, dev, 1, cpu);
+  default: break ;
+  }
+
+  return 0;
+}
+
+void waiter_close(waiter_t* w)
+{
+  switch (w->mode)
+  {
+  case WAIT_EPOLL: evloop_close(&w->loop); break ;
+  case WAIT_URING:
+  case WAIT_URING_SQPOLL: uring_close(&w->uring); break ;
+  default: break ;
+  }
+}
+
+static uint64_t get_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static int busy_wait(waiter_t* w, unsigned int ms, uint32_t* mask)
+{
+  /* spin until REG_COUNT moves, the IRQ is not used */
+
+  const uint64_t deadline = get_ms() + ms;
+  uint32_t x;
+  size_t i;
+
+  *mask = 0;
+
+  for (i = 1; 1; ++i)
+  {
+    dev_rd32(w->dev, REG_COUNT, &x);
+    if (x != w->count) break ;
+    if (((i & 0xff) == 0) && (get_ms() >= deadline)) return 0;
+  }
+
+  w->count = x;
+  *mask = 1 << 1;
+
+  return 0;
+}
+
+int waiter_wait(waiter_t* w, unsigned int ms, uint32_t* mask)
+{
+  switch (w->mode)
+  {
+  case WAIT_EPOLL: return evloop_wait(&w->loop, ms, mask);
+  case WAIT_URING:
+  case WAIT_URING_SQPOLL: return uring_wait(&w->uring, ms, mask);
+  case WAIT_BUSY: return busy_wait(w, ms, mask);
+  default: break ;
+  }
+
+  return dev_wait(w->dev, ms, mask);
+}
@@ -0,0 +1,41 @@
+#ifndef WAITER_H_INCLUDED
+#define WAITER_H_INCLUDED
+
+
+/* IRQ wait, in one of the -wait modes: directly in the device wait */
+/* call, in an epoll event loop (evloop.h), through io_uring with or */
+/* without SQPOLL (uring.h), or busy spinning on REG_COUNT */
+
+
+#include <stdint.h>
+#include "dev.h"
+#include "evloop.h"
+#include "uring.h"
+
+
+#define WAIT_DIRECT 0
+#define WAIT_EPOLL 1
+#define WAIT_URING 2
+#define WAIT_URING_SQPOLL 3
+#define WAIT_BUSY 4
+#define WAIT_COUNT 5
+
+typedef struct waiter
+{
+  unsigned int mode;
+  dev_handle_t* dev;
+  evloop_t loop;
+  uring_t uring;
+  /* busy, the last REG_COUNT */
+  uint32_t count;
+} waiter_t;
+
+int waiter_find_mode(const char*, unsigned int*);
+const char* waiter_mode_name(unsigned int);
+int waiter_open
+(waiter_t*, dev_handle_t*, unsigned int, int, const evloop_feeder_t*);
+void waiter_close(waiter_t*);
+int waiter_wait(waiter_t*, unsigned int, uint32_t*);
+
+
+#endif /* WAITER_H_INCLUDED */
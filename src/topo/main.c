@@ -0,0 +1,402 @@
+/* core to core cache line round trip latency matrix */
+
+/* for each pair of cpus, two pinned threads ping pong a counter in one */
+/* cache line: the pinger writes an odd value, the ponger waits for it */
+/* and writes the next even value, the pinger waits for it. the round */
+/* trip latency of a pair is the minimum over samples of the mean round */
+/* trip time of a sample, which filters out the interrupted samples. */
+/* the matrix tells where the line transfers are cheap (smt siblings, */
+/* shared caches) and where they cross sockets or dies, and is used to */
+/* choose the rt, consumer and irq cpus. */
+
+/* isolated cpus are skipped unless -isolated 1 is given. even then the */
+/* threads only run SCHED_OTHER, with short samples, and sleep between */
+/* pairs, so that an rt task already running there is barely disturbed. */
+
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+
+#define CONFIG_DEBUG 1
+#if (CONFIG_DEBUG == 1)
+#define PERROR() \
+do { printf("[!] %s,%d\n", __FILE__, __LINE__); } while (0)
+#else
+#define PERROR()
+#endif
+
+
+#define CACHE_LINE_SIZE 64
+
+/* a round trip longer than this is a failure, the peer does not run */
+#define PAIR_TIMEOUT_NS 1000000000ULL
+
+/* sleep between pairs, in us */
+#define PAIR_SLEEP_US 10000
+
+
+/* command line parsing */
+
+typedef struct cmdline
+{
+  const char* cpus;
+  unsigned int is_isolated;
+  size_t count;
+  size_t nsamples;
+} cmdline_t;
+
+static uint32_t get_num(const char* s)
+{
+  int base = 10;
+  if ((strlen(s) > 2) && (s[0] == '0') && (s[1] == 'x')) base = 16;
+  return (uint32_t)strtoul(s, NULL, base);
+}
+
+static int get_cmdline(cmdline_t* cmd, size_t ac, char** av)
+{
+  /* -cpus <list>: measured cpus, ie. 0-3,8. default all online. */
+  /* -isolated <0|1>: also measure isolated cpus, default 0 */
+  /* -count <count>: round trips per sample, default 1000 */
+  /* -samples <count>: samples per pair, default 100 */
+
+  size_t i;
+
+  if (ac & 1) goto on_error;
+
+  cmd->cpus = NULL;
+  cmd->is_isolated = 0;
+  cmd->count = 1000;
+  cmd->nsamples = 100;
+
+  for (i = 0; i != ac; i += 2)
+  {
+    if (strcmp(av[i], "-cpus") == 0) cmd->cpus = av[i + 1];
+    else if (strcmp(av[i], "-isolated") == 0)
+      cmd->is_isolated = get_num(av[i + 1]);
+    else if (strcmp(av[i], "-count") == 0) cmd->count = get_num(av[i + 1]);
+    else if (strcmp(av[i], "-samples") == 0) cmd->nsamples = get_num(av[i + 1]);
+    else goto on_error;
+  }
+
+  if ((cmd->count == 0) || (cmd->nsamples == 0)) goto on_error;
+
+  return 0;
+ on_error:
+  return -1;
+}
+
+
+/* cpu lists */
+
+static int parse_cpus(const char* s, cpu_set_t* set)
+{
+  /* comma separated cpus and ranges, ie. 0-3,8 */
+
+  unsigned long a;
+  unsigned long b;
+  char* end;
+
+  CPU_ZERO(set);
+
+  while ((*s != 0) && (*s != '\n'))
+  {
+    a = strtoul(s, &end, 10);
+    if (end == s) return -1;
+    b = a;
+    s = end;
+    if (*s == '-')
+    {
+      b = strtoul(s + 1, &end, 10);
+      if (end == (s + 1)) return -1;
+      s = end;
+    }
+    if ((a > b) || (b >= CPU_SETSIZE)) return -1;
+    for (; a <= b; ++a) CPU_SET(a, set);
+    if (*s == ',') ++s;
+  }
+
+  return 0;
+}
+
+static int read_cpus(const char* path, cpu_set_t* set)
+{
+  /* a missing or empty file is an empty set */
+
+  char buf[1024];
+  FILE* file;
+  int err = 0;
+
+  CPU_ZERO(set);
+
+  file = fopen(path, "r");
+  if (file == NULL) return 0;
+  if (fgets(buf, sizeof(buf), file) != NULL) err = parse_cpus(buf, set);
+  fclose(file);
+
+  return err;
+}
+
+static int is_sibling(int a, int b)
+{
+  char path[128];
+  cpu_set_t set;
+
+  snprintf(path, sizeof(path),
+	   "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", a);
+  if (read_cpus(path, &set)) return 0;
+  return CPU_ISSET(b, &set);
+}
+
+
+/* ping pong */
+
+typedef struct pair
+{
+  /* alone in its line */
+  volatile uint64_t x __attribute__((aligned(CACHE_LINE_SIZE)));
+  uint8_t pad[CACHE_LINE_SIZE - sizeof(uint64_t)];
+
+  int cpus[2];
+  size_t nrounds;
+  volatile unsigned int is_done;
+  int err;
+} pair_t;
+
+static uint64_t get_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int pin_self(int cpu)
+{
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) ? -1 : 0;
+}
+
+static void* pong_main(void* args)
+{
+  pair_t* const p = (pair_t*)args;
+  uint64_t x;
+
+  if (pin_self(p->cpus[1]))
+  {
+    p->err = -1;
+    return NULL;
+  }
+
+  /* answer every odd value with the next even value */
+
+  while (p->is_done == 0)
+  {
+    x = __atomic_load_n(&p->x, __ATOMIC_ACQUIRE);
+    if (x & 1) __atomic_store_n(&p->x, x + 1, __ATOMIC_RELEASE);
+  }
+
+  return NULL;
+}
+
+static int wait_value(pair_t* p, uint64_t x, uint64_t deadline)
+{
+  size_t i;
+
+  for (i = 1; __atomic_load_n(&p->x, __ATOMIC_ACQUIRE) != x; ++i)
+  {
+    if (((i & 0xffff) == 0) && (get_ns() > deadline)) return -1;
+  }
+
+  return 0;
+}
+
+static int measure_pair(const cmdline_t* cmd, int a, int b, double* rtt)
+{
+  /* the calling thread pings from a, a new thread pongs from b */
+
+  pair_t* p;
+  pthread_t thread;
+  uint64_t x;
+  uint64_t t;
+  uint64_t dt;
+  uint64_t best = (uint64_t)-1;
+  size_t i;
+  size_t j;
+  int err = -1;
+
+  if (posix_memalign((void**)&p, CACHE_LINE_SIZE, sizeof(pair_t)))
+    goto on_error_0;
+  memset(p, 0, sizeof(pair_t));
+  p->cpus[0] = a;
+  p->cpus[1] = b;
+
+  if (pin_self(a)) goto on_error_1;
+  if (pthread_create(&thread, NULL, pong_main, p)) goto on_error_1;
+
+  /* the first round trip also waits for the ponger to start */
+
+  x = 1;
+  __atomic_store_n(&p->x, x, __ATOMIC_RELEASE);
+  if (wait_value(p, x + 1, get_ns() + PAIR_TIMEOUT_NS)) goto on_error_2;
+  x += 2;
+
+  for (i = 0; i != cmd->nsamples; ++i)
+  {
+    t = get_ns();
+    for (j = 0; j != cmd->count; ++j, x += 2)
+    {
+      __atomic_store_n(&p->x, x, __ATOMIC_RELEASE);
+      if (wait_value(p, x + 1, t + PAIR_TIMEOUT_NS)) goto on_error_2;
+    }
+    dt = get_ns() - t;
+    if (dt < best) best = dt;
+  }
+
+  *rtt = (double)best / (double)cmd->count;
+  err = 0;
+
+ on_error_2:
+  p->is_done = 1;
+  pthread_join(thread, NULL);
+  if (p->err) err = -1;
+ on_error_1:
+  free(p);
+ on_error_0:
+  return err;
+}
+
+
+/* main */
+
+int main(int ac, char** av)
+{
+  cmdline_t cmd;
+  cpu_set_t online;
+  cpu_set_t isolated;
+  cpu_set_t measured;
+  int cpus[CPU_SETSIZE];
+  double* rtts;
+  size_t ncpus;
+  size_t i;
+  size_t j;
+  int best[3] = { -1, -1, -1 };
+  double best_rtt;
+  int err = -1;
+
+  if (get_cmdline(&cmd, (size_t)ac - 1, av + 1)) goto on_error_0;
+
+  if (read_cpus("/sys/devices/system/cpu/online", &online)) goto on_error_0;
+  if (read_cpus("/sys/devices/system/cpu/isolated", &isolated)) goto on_error_0;
+
+  measured = online;
+  if (cmd.cpus != NULL)
+  {
+    if (parse_cpus(cmd.cpus, &measured)) goto on_error_0;
+    CPU_AND(&measured, &measured, &online);
+  }
+
+  ncpus = 0;
+  for (i = 0; i != CPU_SETSIZE; ++i)
+  {
+    if (CPU_ISSET(i, &measured) == 0) continue ;
+    if (CPU_ISSET(i, &isolated) && (cmd.is_isolated == 0))
+    {
+      printf("# skipped: cpu %zu is isolated\n", i);
+      continue ;
+    }
+    cpus[ncpus++] = (int)i;
+  }
+
+  if (ncpus < 2)
+  {
+    PERROR();
+    goto on_error_0;
+  }
+
+  rtts = malloc(ncpus * ncpus * sizeof(double));
+  if (rtts == NULL) goto on_error_0;
+
+  /* the matrix is symmetric in theory, both directions are measured */
+
+  for (i = 0; i != ncpus; ++i)
+  {
+    for (j = 0; j != ncpus; ++j)
+    {
+      rtts[i * ncpus + j] = 0;
+      if (i == j) continue ;
+      if (measure_pair(&cmd, cpus[i], cpus[j], &rtts[i * ncpus + j]))
+      {
+	printf("[!] pair %d %d\n", cpus[i], cpus[j]);
+	rtts[i * ncpus + j] = -1;
+      }
+      usleep(PAIR_SLEEP_US);
+    }
+  }
+
+  /* round trip latencies in ns, rows ping, columns pong */
+
+  printf("# rtt_ns");
+  for (j = 0; j != ncpus; ++j) printf(" %d", cpus[j]);
+  printf("\n");
+
+  for (i = 0; i != ncpus; ++i)
+  {
+    printf("%d", cpus[i]);
+    for (j = 0; j != ncpus; ++j)
+    {
+      if (i == j) printf(" -");
+      else printf(" %.1f", rtts[i * ncpus + j]);
+    }
+    printf("\n");
+  }
+
+  /* rt and consumer: the closest pair, smt siblings excluded as they */
+  /* compete for the same core. irq: the cpu closest to the rt one. */
+
+  best_rtt = 0;
+  for (i = 0; i != ncpus; ++i)
+  {
+    for (j = 0; j != ncpus; ++j)
+    {
+      const double x = rtts[i * ncpus + j];
+      if ((i == j) || (x <= 0)) continue ;
+      if (is_sibling(cpus[i], cpus[j])) continue ;
+      if ((best[0] != -1) && (x >= best_rtt)) continue ;
+      best[0] = (int)i;
+      best[1] = (int)j;
+      best_rtt = x;
+    }
+  }
+
+  if (best[0] != -1)
+  {
+    best_rtt = 0;
+    for (j = 0; j != ncpus; ++j)
+    {
+      const double x = rtts[(size_t)best[0] * ncpus + j];
+      if (((int)j == best[0]) || ((int)j == best[1]) || (x <= 0)) continue ;
+      if ((best[2] != -1) && (x >= best_rtt)) continue ;
+      best[2] = (int)j;
+      best_rtt = x;
+    }
+
+    printf("# suggest: rt=%d consumer=%d", cpus[best[0]], cpus[best[1]]);
+    if (best[2] != -1) printf(" irq=%d", cpus[best[2]]);
+    printf("\n");
+  }
+
+  err = 0;
+
+  free(rtts);
+ on_error_0:
+  return err;
+}